@@ -0,0 +1,952 @@
+// Headless render benchmark for the ported modules.
+//
+// Drives the engines behind Braids, Clouds and Elements, the audio paths of
+// Blinds and Links, and the resampler without Rack, renders a number of seconds
+// with scripted parameter and CV sweeps, and reports the cost of each module
+// and mode.
+//
+// With -e it instead measures the resampler's frequency response, and checks
+// its rejection of aliases and images just above the slower Nyquist frequency.
+//
+// With -w or -c it instead renders fixed-length golden outputs and records or
+// checks them against references. Fixed-point paths must stay bit-exact, and
+// float paths, which may differ with the compiler and CPU, within an SNR bound.
+// With -g or -t it records or checks only the hashes of the fixed-point paths,
+// which `make test` checks against bench/golden.txt.
+//
+// Build with `make bench`, then run `build/AudibleInstrumentsBench -h`.
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <math.h>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+
+#include "stmlib/utils/random.h"
+
+#include "core/BraidsEngine.hpp"
+#include "core/CloudsEngine.hpp"
+#include "core/ElementsEngine.hpp"
+#include "core/BlindsEngine.hpp"
+#include "core/LinksEngine.hpp"
+#include "core/Resampler.hpp"
+
+
+static const char *cloudsModeNames[] = {
+	"granular", "stretch", "looping", "spectral",
+};
+
+static const char *elementsModelNames[] = {
+	"modal", "string", "chords",
+};
+
+static const char *resamplerQualityNames[] = {
+	"low", "balanced", "high",
+};
+
+
+/** Triangle sweep between 0 and 1 with the given period in seconds */
+static float sweep(float t, float period) {
+	float phase = t / period;
+	phase -= floorf(phase);
+	return (phase < 0.5f) ? 2.f * phase : 2.f - 2.f * phase;
+}
+
+
+/** A module core and its parameter script */
+struct Scenario {
+	std::string name;
+	/** Samples produced by the last block, for the golden renders */
+	const float *output = NULL;
+	int outputLen = 0;
+
+	virtual ~Scenario() {}
+	/** Returns the rate in Hz at which `block()` produces frames, given the host rate */
+	virtual float getRate(float hostRate) = 0;
+	virtual int getBlockSize() = 0;
+	/** Sets up the core and renders one block at time `t` in seconds */
+	virtual void block(float t) = 0;
+	/** Does the work the module does off the audio thread, between blocks and outside the timings */
+	virtual void background() {}
+	/** Returns whether golden renders must match the reference bit for bit, rather than within the SNR bound.
+	Only fixed-point paths are exact, since float results depend on the compiler and CPU.
+	*/
+	virtual bool isExact() {
+		return false;
+	}
+};
+
+
+struct BraidsScenario : Scenario {
+	BraidsEngine engine;
+	/** Shape knob position */
+	float shape;
+	bool lowCpu;
+	int voices;
+	/** Internal rate when not in low CPU mode */
+	int renderRate;
+	float lastStrike = 0.f;
+	float out[BraidsEngine::BLOCK_SIZE * BraidsEngine::MAX_VOICES];
+
+	BraidsScenario(int shape, bool lowCpu, int voices = 1, int renderRate = BraidsEngine::SAMPLE_RATE) : lowCpu(lowCpu), voices(voices), renderRate(renderRate) {
+		name = std::string("braids/") + BraidsEngine::shapeNames[shape] + (lowCpu ? "/lowcpu" : "");
+		if (voices > 1)
+			name += "/poly" + std::to_string(voices);
+		if (renderRate != BraidsEngine::SAMPLE_RATE)
+			name += "/" + std::to_string(renderRate / 1000) + "k";
+		this->shape = (float) shape / braids::MACRO_OSC_SHAPE_LAST_ACCESSIBLE_FROM_META;
+		output = out;
+		outputLen = BraidsEngine::BLOCK_SIZE * voices;
+	}
+
+	float getRate(float hostRate) override {
+		float rate = lowCpu ? hostRate : renderRate;
+		engine.setSampleRate(rate);
+		return rate;
+	}
+
+	int getBlockSize() override {
+		return BraidsEngine::BLOCK_SIZE;
+	}
+
+	bool isExact() override {
+		return !engine.floatPath;
+	}
+
+	void block(float t) override {
+		// Strike twice per second for the percussive shapes
+		if (t - lastStrike >= 0.5f) {
+			for (int c = 0; c < voices; c++) {
+				engine.strike(c);
+			}
+			lastStrike = t;
+		}
+
+		for (int c = 0; c < voices; c++) {
+			BraidsEngine::Controls controls;
+			controls.shape = shape;
+			controls.timbre = sweep(t, 3.f);
+			controls.color = sweep(t, 5.f);
+			// Two octave pitch sweep around C4, with the voices a semitone apart
+			controls.pitch = 2.f * sweep(t, 7.f) - 1.f + c / 12.f;
+
+			engine.render(c, controls, &out[c], voices);
+		}
+	}
+};
+
+
+struct CloudsScenario : Scenario {
+	CloudsEngine engine;
+	float lastTrigger = 0.f;
+	uint32_t noise = 1;
+	float in[2 * CloudsEngine::BLOCK_SIZE];
+	float out[2 * CloudsEngine::BLOCK_SIZE];
+
+	/** Runs the processor at the host rate */
+	bool nativeRate;
+	/** Steps through the qualities twice per second, as if the setting were changed while playing */
+	bool switching = false;
+
+	CloudsScenario(clouds::PlaybackMode playback, int quality, bool nativeRate = false) : nativeRate(nativeRate) {
+		name = std::string("clouds/") + cloudsModeNames[playback] + "/q" + std::to_string(quality) + (nativeRate ? "/native" : "");
+		engine.playback = playback;
+		engine.quality = quality;
+		output = out;
+		outputLen = 2 * CloudsEngine::BLOCK_SIZE;
+	}
+
+	float getRate(float hostRate) override {
+		engine.setSampleRate(nativeRate ? (int) hostRate : CloudsEngine::SAMPLE_RATE);
+		if (engine.needsMemory())
+			engine.allocateMemory();
+		return engine.sampleRate;
+	}
+
+	void background() override {
+		// The module's memory worker prepares memory for new settings, so its cost stays out of the block timings
+		if (engine.needsMemory())
+			engine.allocateMemory();
+	}
+
+	int getBlockSize() override {
+		return CloudsEngine::BLOCK_SIZE;
+	}
+
+	void block(float t) override {
+		if (switching)
+			engine.quality = (int) (2.f * t) % 4;
+
+		// Decaying noise bursts so the buffer always has material in it
+		float env = 1.f - sweep(t, 0.5f);
+		for (int i = 0; i < CloudsEngine::BLOCK_SIZE; i++) {
+			noise = noise * 1664525 + 1013904223;
+			float s = (int32_t) noise / 4294967296.f * env;
+			in[2 * i + 0] = s;
+			in[2 * i + 1] = s;
+		}
+
+		CloudsEngine::Controls controls;
+		controls.trigger = (t - lastTrigger >= 0.25f);
+		if (controls.trigger)
+			lastTrigger = t;
+		controls.position = sweep(t, 5.f);
+		controls.size = sweep(t, 7.f);
+		controls.pitch = 24.f * sweep(t, 11.f) - 12.f;
+		// Keep density high so the grain scheduler is busy
+		controls.density = 0.6f + 0.4f * sweep(t, 3.f);
+		controls.texture = sweep(t, 13.f);
+		controls.dryWet = 1.f;
+		controls.spread = 0.5f;
+		controls.feedback = 0.3f;
+		controls.reverb = 0.3f;
+
+		engine.process(controls, in, out);
+	}
+};
+
+
+struct ElementsScenario : Scenario {
+	ElementsEngine engine;
+	float blow[ElementsEngine::BLOCK_SIZE] = {};
+	float strike[ElementsEngine::BLOCK_SIZE] = {};
+	/** Main and aux outputs */
+	float out[2][ElementsEngine::BLOCK_SIZE];
+
+	ElementsScenario(int model) {
+		name = std::string("elements/") + elementsModelNames[model];
+		engine.setModel(model);
+		output = &out[0][0];
+		outputLen = 2 * ElementsEngine::BLOCK_SIZE;
+	}
+
+	float getRate(float hostRate) override {
+		return ElementsEngine::SAMPLE_RATE;
+	}
+
+	int getBlockSize() override {
+		return ElementsEngine::BLOCK_SIZE;
+	}
+
+	void block(float t) override {
+		elements::Patch *p = engine.patch();
+		p->exciter_envelope_shape = sweep(t, 3.f);
+		p->exciter_bow_level = 0.5f;
+		p->exciter_blow_level = 0.5f;
+		p->exciter_strike_level = 0.5f;
+		p->exciter_bow_timbre = sweep(t, 5.f) * 0.9995f;
+		p->exciter_blow_meta = sweep(t, 7.f) * 0.9995f;
+		p->exciter_blow_timbre = sweep(t, 11.f) * 0.9995f;
+		p->exciter_strike_meta = sweep(t, 13.f) * 0.9995f;
+		p->exciter_strike_timbre = sweep(t, 17.f) * 0.9995f;
+		p->resonator_geometry = sweep(t, 19.f) * 0.9995f;
+		p->resonator_brightness = sweep(t, 23.f) * 0.9995f;
+		p->resonator_damping = sweep(t, 29.f) * 0.9995f;
+		p->resonator_position = sweep(t, 31.f) * 0.9995f;
+		p->space = 2.f * sweep(t, 37.f);
+
+		elements::PerformanceState performance;
+		performance.note = 12.f * (2.f * sweep(t, 9.f) - 1.f) + 69.f;
+		performance.modulation = 0.f;
+		// Gate on for half of each second
+		performance.gate = (t - floorf(t)) < 0.5f;
+		performance.strength = 0.5f;
+
+		engine.process(performance, blow, strike, out[0], out[1]);
+	}
+};
+
+
+struct BlindsScenario : Scenario {
+	/** Outputs 2 and 4 are patched, so channels 1 and 3 are summed into the next one */
+	bool connected[BlindsEngine::NUM_CHANNELS] = {false, true, false, true};
+	float out[BlindsEngine::NUM_CHANNELS];
+
+	BlindsScenario() {
+		name = "blinds";
+		output = out;
+		outputLen = BlindsEngine::NUM_CHANNELS;
+	}
+
+	float getRate(float hostRate) override {
+		return hostRate;
+	}
+
+	int getBlockSize() override {
+		return 1;
+	}
+
+	void block(float t) override {
+		float gains[BlindsEngine::NUM_CHANNELS];
+		float in[BlindsEngine::NUM_CHANNELS];
+		for (int i = 0; i < BlindsEngine::NUM_CHANNELS; i++) {
+			// Gain knob and attenuverter sweeps, with an audio rate CV
+			float cv = 10.f * sweep(t, 0.001f * (i + 1)) - 5.f;
+			gains[i] = BlindsEngine::getGain(2.f * sweep(t, 1.f + i) - 1.f, 2.f * sweep(t, 3.f + i) - 1.f, cv);
+			// Unpatched inputs are normalled to 5V
+			in[i] = (i % 2 == 0) ? 10.f * sweep(t, 0.01f) - 5.f : 5.f;
+		}
+		BlindsEngine::process(gains, in, connected, out);
+	}
+};
+
+
+struct LinksScenario : Scenario {
+	float out[LinksEngine::NUM_OUTPUTS];
+
+	LinksScenario() {
+		name = "links";
+		output = out;
+		outputLen = LinksEngine::NUM_OUTPUTS;
+	}
+
+	float getRate(float hostRate) override {
+		return hostRate;
+	}
+
+	int getBlockSize() override {
+		return 1;
+	}
+
+	void block(float t) override {
+		float in[LinksEngine::NUM_INPUTS];
+		for (int i = 0; i < LinksEngine::NUM_INPUTS; i++) {
+			in[i] = 10.f * sweep(t, 0.01f * (i + 1)) - 5.f;
+		}
+		LinksEngine::process(in, out);
+	}
+};
+
+
+/** Stereo chirp through the resampler, sweeping up to the input Nyquist frequency so the stopband is exercised */
+struct ResamplerScenario : Scenario {
+	static const int BLOCK_SIZE = 32;
+	Resampler<2> src;
+	int inRate;
+	double phase = 0.0;
+	float in[2 * BLOCK_SIZE];
+	/** Room for a block at the highest ratio of the scenarios */
+	float out[2 * 4 * BLOCK_SIZE];
+
+	ResamplerScenario(ResamplerQuality quality, int inRate, int outRate) : inRate(inRate) {
+		name = std::string("resampler/") + resamplerQualityNames[quality] + "/" + std::to_string(inRate) + "-" + std::to_string(outRate);
+		src.setRates(inRate, outRate);
+		src.setQuality(quality);
+		output = out;
+	}
+
+	float getRate(float hostRate) override {
+		return inRate;
+	}
+
+	int getBlockSize() override {
+		return BLOCK_SIZE;
+	}
+
+	void block(float t) override {
+		float freq = 20.f + sweep(t, 1.f) * 0.5f * inRate;
+		for (int i = 0; i < BLOCK_SIZE; i++) {
+			phase += (double) freq / inRate;
+			phase -= floor(phase);
+			float s = 0.5f * sinf(2 * M_PI * phase);
+			in[2 * i + 0] = s;
+			in[2 * i + 1] = -s;
+		}
+		int inFrames = BLOCK_SIZE;
+		int outFrames = 4 * BLOCK_SIZE;
+		src.process(in, &inFrames, out, &outFrames);
+		outputLen = 2 * outFrames;
+	}
+};
+
+
+/** Converts another scenario's output to the host rate with the module's resampler settings, as Braids and Clouds do before their outputs */
+struct ModuleScenario : Scenario {
+	static const int MAX_CHANNELS = BraidsEngine::MAX_VOICES;
+	Scenario *scenario;
+	int channels;
+	Resampler<MAX_CHANNELS> src;
+	std::vector<float> in;
+	std::vector<float> resampled;
+	std::vector<float> out;
+
+	ModuleScenario(Scenario *scenario, int channels, ResamplerQuality quality = RESAMPLER_HIGH_QUALITY) : scenario(scenario), channels(channels) {
+		name = scenario->name + "/resampled";
+		src.setChannels(channels);
+		src.setQuality(quality);
+	}
+
+	~ModuleScenario() {
+		delete scenario;
+	}
+
+	float getRate(float hostRate) override {
+		float rate = scenario->getRate(hostRate);
+		src.setRates((int) rate, (int) hostRate);
+		// Room for a block at up to 4 times the rate
+		int frames = scenario->getBlockSize();
+		in.resize(frames * MAX_CHANNELS);
+		resampled.resize(4 * frames * MAX_CHANNELS);
+		out.resize(4 * frames * channels);
+		output = out.data();
+		return rate;
+	}
+
+	int getBlockSize() override {
+		return scenario->getBlockSize();
+	}
+
+	void background() override {
+		scenario->background();
+	}
+
+	void block(float t) override {
+		scenario->block(t);
+		// The resampler takes frames of MAX_CHANNELS, like the modules' dsp::Frame buffers
+		int inFrames = scenario->outputLen / channels;
+		for (int i = 0; i < inFrames; i++) {
+			for (int c = 0; c < channels; c++) {
+				in[i * MAX_CHANNELS + c] = scenario->output[i * channels + c];
+			}
+		}
+		int outFrames = resampled.size() / MAX_CHANNELS;
+		src.process(in.data(), &inFrames, resampled.data(), &outFrames);
+		for (int i = 0; i < outFrames; i++) {
+			for (int c = 0; c < channels; c++) {
+				out[i * channels + c] = resampled[i * MAX_CHANNELS + c];
+			}
+		}
+		outputLen = outFrames * channels;
+	}
+};
+
+
+static void createScenarios(std::vector<Scenario*> &scenarios) {
+	for (int shape = 0; shape <= braids::MACRO_OSC_SHAPE_LAST_ACCESSIBLE_FROM_META; shape++) {
+		scenarios.push_back(new BraidsScenario(shape, false));
+	}
+	for (int shape = 0; shape <= braids::MACRO_OSC_SHAPE_LAST_ACCESSIBLE_FROM_META; shape++) {
+		scenarios.push_back(new BraidsScenario(shape, true));
+	}
+	for (int shape = 0; shape <= braids::MACRO_OSC_SHAPE_LAST_ACCESSIBLE_FROM_META; shape++) {
+		scenarios.push_back(new BraidsScenario(shape, false, BraidsEngine::MAX_VOICES));
+	}
+	for (int scale : {1, 2}) {
+		// Pitch sweep through the quantizer
+		BraidsScenario *scenario = new BraidsScenario(0, false);
+		scenario->engine.settings.quantizer_scale = scale;
+		scenario->name += std::string("/") + BraidsEngine::scaleNames[scale];
+		scenarios.push_back(scenario);
+	}
+	for (int chord : {4, 6}) {
+		// Chord tones across all oscillators
+		BraidsScenario *scenario = new BraidsScenario(0, false, BraidsEngine::MAX_VOICES / BraidsEngine::chordTones[chord]);
+		scenario->engine.chord = chord;
+		scenario->name += std::string("/") + BraidsEngine::chordNames[chord];
+		scenarios.push_back(scenario);
+	}
+	for (int shape = 0; shape <= braids::MACRO_OSC_SHAPE_LAST_ACCESSIBLE_FROM_META; shape++) {
+		BraidsScenario *scenario = new BraidsScenario(shape, false);
+		scenario->engine.floatPath = true;
+		scenario->name += "/float";
+		scenarios.push_back(scenario);
+	}
+	for (int rate : {48000, 192000}) {
+		for (int shape = 0; shape <= braids::MACRO_OSC_SHAPE_LAST_ACCESSIBLE_FROM_META; shape++) {
+			scenarios.push_back(new BraidsScenario(shape, false, 1, rate));
+		}
+	}
+	for (int playback = 0; playback < 4; playback++) {
+		for (int quality = 0; quality < 4; quality++) {
+			scenarios.push_back(new CloudsScenario((clouds::PlaybackMode) playback, quality));
+		}
+		scenarios.push_back(new CloudsScenario((clouds::PlaybackMode) playback, 0, true));
+	}
+	{
+		// Quality changes with a long recording, whose peak cost shows whether buffers are cleared on the audio thread
+		CloudsScenario *scenario = new CloudsScenario(clouds::PLAYBACK_MODE_GRANULAR, 0);
+		scenario->engine.duration = 60.f;
+		scenario->switching = true;
+		scenario->name += "/60s/switching";
+		scenarios.push_back(scenario);
+	}
+	for (int model = 0; model < 3; model++) {
+		scenarios.push_back(new ElementsScenario(model));
+	}
+	// Module output paths, from Braids' 96 kHz render and Clouds' 32 kHz to the host rate
+	scenarios.push_back(new ModuleScenario(new BraidsScenario(0, false, 4), 4));
+	scenarios.push_back(new ModuleScenario(new CloudsScenario(clouds::PLAYBACK_MODE_GRANULAR, 0), 2));
+	scenarios.push_back(new BlindsScenario());
+	scenarios.push_back(new LinksScenario());
+	for (int quality = 0; quality < NUM_RESAMPLER_QUALITIES; quality++) {
+		// 2:1 and 1:2, Braids' 96 kHz render to a 44.1 kHz host, and a 48 kHz host to Clouds' 32 kHz
+		scenarios.push_back(new ResamplerScenario((ResamplerQuality) quality, 96000, 48000));
+		scenarios.push_back(new ResamplerScenario((ResamplerQuality) quality, 48000, 96000));
+		scenarios.push_back(new ResamplerScenario((ResamplerQuality) quality, 96000, 44100));
+		scenarios.push_back(new ResamplerScenario((ResamplerQuality) quality, 48000, 32000));
+	}
+}
+
+
+/** Renders `seconds` of audio, optionally capturing the output and timing each block */
+static void render(Scenario *scenario, float seconds, float hostRate, std::vector<float> *capture, double *total, double *peak) {
+	typedef std::chrono::steady_clock Clock;
+
+	// The eurorack code shares one random generator, so reseed it to make each render independent of the ones before it
+	stmlib::Random::Seed(0x21);
+
+	float rate = scenario->getRate(hostRate);
+	int blockSize = scenario->getBlockSize();
+	long blocks = (long) ceilf(seconds * rate / blockSize);
+	float blockTime = blockSize / rate;
+
+	for (long i = 0; i < blocks; i++) {
+		Clock::time_point start = Clock::now();
+		scenario->block(i * blockTime);
+		Clock::time_point end = Clock::now();
+		scenario->background();
+		if (total) {
+			double ns = std::chrono::duration<double, std::nano>(end - start).count();
+			*total += ns;
+			*peak = std::max(*peak, ns);
+		}
+		if (capture)
+			capture->insert(capture->end(), scenario->output, scenario->output + scenario->outputLen);
+	}
+}
+
+
+static void run(Scenario *scenario, float seconds, float hostRate) {
+	double total = 0.0;
+	double peak = 0.0;
+	render(scenario, seconds, hostRate, NULL, &total, &peak);
+
+	// Report per host sample, so modules with different internal rates are comparable
+	float rate = scenario->getRate(hostRate);
+	int blockSize = scenario->getBlockSize();
+	double renderedSeconds = ceilf(seconds * rate / blockSize) * blockSize / rate;
+	double nsPerSample = total / (renderedSeconds * hostRate);
+	double realtime = renderedSeconds / (total * 1e-9);
+	printf("%-24s %10.1f %12.1f %12.2f\n", scenario->name.c_str(), nsPerSample, realtime, peak * 1e-3);
+}
+
+
+/** 64-bit FNV-1a hash of the sample bits */
+static uint64_t hashSamples(const std::vector<float> &samples) {
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	const uint8_t *bytes = (const uint8_t*) samples.data();
+	for (size_t i = 0; i < samples.size() * sizeof(float); i++) {
+		hash ^= bytes[i];
+		hash *= 0x100000001b3ULL;
+	}
+	return hash;
+}
+
+/** Path of the reference samples of a scenario, with characters that are unsafe in file names escaped */
+static std::string referencePath(const std::string &dir, const std::string &name) {
+	std::string path = dir + "/";
+	for (char c : name) {
+		if (isalnum((unsigned char) c) || c == '-' || c == '_') {
+			path += c;
+		}
+		else {
+			char escape[4];
+			snprintf(escape, sizeof(escape), "%%%02X", (unsigned char) c);
+			path += escape;
+		}
+	}
+	return path + ".f32";
+}
+
+static bool writeSamples(const std::string &path, const std::vector<float> &samples) {
+	FILE *f = fopen(path.c_str(), "wb");
+	if (!f)
+		return false;
+	size_t written = fwrite(samples.data(), sizeof(float), samples.size(), f);
+	fclose(f);
+	return written == samples.size();
+}
+
+static bool readSamples(const std::string &path, std::vector<float> &samples) {
+	FILE *f = fopen(path.c_str(), "rb");
+	if (!f)
+		return false;
+	float buffer[1024];
+	size_t n;
+	while ((n = fread(buffer, sizeof(float), 1024, f)) > 0) {
+		samples.insert(samples.end(), buffer, buffer + n);
+	}
+	fclose(f);
+	return true;
+}
+
+/** Signal to error ratio in dB, or infinity if the signals are identical */
+static double snr(const std::vector<float> &reference, const std::vector<float> &samples) {
+	if (reference.size() != samples.size())
+		return -INFINITY;
+	double signal = 0.0;
+	double noise = 0.0;
+	for (size_t i = 0; i < reference.size(); i++) {
+		double error = (double) samples[i] - reference[i];
+		signal += (double) reference[i] * reference[i];
+		noise += error * error;
+	}
+	if (noise == 0.0)
+		return INFINITY;
+	// Silent references only match silent outputs
+	if (signal == 0.0)
+		return -INFINITY;
+	return 10.0 * log10(signal / noise);
+}
+
+
+/** Golden render settings, fixed so references stay comparable */
+static const float goldenSeconds = 1.f;
+static const float goldenRate = 48000.f;
+
+/** Renders every scenario and writes its hash to DIR/hashes.txt and its samples to DIR */
+static int recordGolden(const std::vector<Scenario*> &scenarios, const std::string &dir) {
+	std::string hashesPath = dir + "/hashes.txt";
+	FILE *hashes = fopen(hashesPath.c_str(), "w");
+	if (!hashes) {
+		fprintf(stderr, "Could not write %s\n", hashesPath.c_str());
+		return 1;
+	}
+	for (Scenario *scenario : scenarios) {
+		std::vector<float> samples;
+		render(scenario, goldenSeconds, goldenRate, &samples, NULL, NULL);
+		fprintf(hashes, "%016llx %s\n", (unsigned long long) hashSamples(samples), scenario->name.c_str());
+		if (!writeSamples(referencePath(dir, scenario->name), samples)) {
+			fprintf(stderr, "Could not write reference of %s\n", scenario->name.c_str());
+			fclose(hashes);
+			return 1;
+		}
+		printf("%-24s recorded\n", scenario->name.c_str());
+	}
+	fclose(hashes);
+	return 0;
+}
+
+/** Reads lines of "HASH NAME" from `path`, skipping others such as comments */
+static bool readHashes(const std::string &path, std::map<std::string, uint64_t> &hashes) {
+	FILE *f = fopen(path.c_str(), "r");
+	if (!f)
+		return false;
+	char line[256];
+	while (fgets(line, sizeof(line), f)) {
+		unsigned long long hash;
+		int n = 0;
+		if (line[0] != '#' && sscanf(line, "%16llx %n", &hash, &n) == 1) {
+			std::string name = line + n;
+			name.erase(name.find_last_not_of("\r\n") + 1);
+			hashes[name] = hash;
+		}
+	}
+	fclose(f);
+	return true;
+}
+
+/** Renders every scenario and compares it with the references in DIR.
+A scenario passes if its hash is unchanged, or if it isn't exact and its SNR against the reference samples is at least `minSnr` dB.
+*/
+static int checkGolden(const std::vector<Scenario*> &scenarios, const std::string &dir, double minSnr) {
+	std::string hashesPath = dir + "/hashes.txt";
+	std::map<std::string, uint64_t> referenceHashes;
+	if (!readHashes(hashesPath, referenceHashes)) {
+		fprintf(stderr, "Could not read %s, record references with -w first\n", hashesPath.c_str());
+		return 1;
+	}
+
+	int failures = 0;
+	for (Scenario *scenario : scenarios) {
+		auto it = referenceHashes.find(scenario->name);
+		if (it == referenceHashes.end()) {
+			printf("%-24s no reference\n", scenario->name.c_str());
+			failures++;
+			continue;
+		}
+		std::vector<float> samples;
+		render(scenario, goldenSeconds, goldenRate, &samples, NULL, NULL);
+		if (hashSamples(samples) == it->second) {
+			printf("%-24s exact\n", scenario->name.c_str());
+			continue;
+		}
+		if (scenario->isExact()) {
+			printf("%-24s FAILED, hash differs\n", scenario->name.c_str());
+			failures++;
+			continue;
+		}
+		std::vector<float> reference;
+		if (!readSamples(referencePath(dir, scenario->name), reference)) {
+			printf("%-24s FAILED, hash differs and reference samples are missing\n", scenario->name.c_str());
+			failures++;
+			continue;
+		}
+		double s = snr(reference, samples);
+		if (s >= minSnr) {
+			printf("%-24s within tolerance, SNR %.1f dB\n", scenario->name.c_str(), s);
+		}
+		else {
+			printf("%-24s FAILED, SNR %.1f dB\n", scenario->name.c_str(), s);
+			failures++;
+		}
+	}
+
+	printf("%d failed\n", failures);
+	return failures > 0 ? 1 : 0;
+}
+
+
+/** Writes the hashes of the exact scenarios to `path`.
+Fixed-point renders don't depend on the compiler or CPU, so the file is committed and checked without reference samples.
+*/
+static int recordHashes(const std::vector<Scenario*> &scenarios, const std::string &path) {
+	FILE *f = fopen(path.c_str(), "w");
+	if (!f) {
+		fprintf(stderr, "Could not write %s\n", path.c_str());
+		return 1;
+	}
+	fprintf(f, "# Hashes of the bench's fixed-point golden renders, %g s at %g Hz.\n", goldenSeconds, goldenRate);
+	fprintf(f, "# Checked by `make test`, rewritten by `make golden` after an intended change to a fixed-point path.\n");
+	for (Scenario *scenario : scenarios) {
+		if (!scenario->isExact())
+			continue;
+		std::vector<float> samples;
+		render(scenario, goldenSeconds, goldenRate, &samples, NULL, NULL);
+		fprintf(f, "%016llx %s\n", (unsigned long long) hashSamples(samples), scenario->name.c_str());
+		printf("%-24s recorded\n", scenario->name.c_str());
+	}
+	fclose(f);
+	return 0;
+}
+
+/** Checks the exact scenarios against the hashes in `path`. Float scenarios need recorded samples, see checkGolden(). */
+static int checkHashes(const std::vector<Scenario*> &scenarios, const std::string &path) {
+	std::map<std::string, uint64_t> referenceHashes;
+	if (!readHashes(path, referenceHashes)) {
+		fprintf(stderr, "Could not read %s\n", path.c_str());
+		return 1;
+	}
+	int failures = 0;
+	for (Scenario *scenario : scenarios) {
+		if (!scenario->isExact())
+			continue;
+		auto it = referenceHashes.find(scenario->name);
+		if (it == referenceHashes.end()) {
+			printf("%-24s FAILED, no reference, record it with -g\n", scenario->name.c_str());
+			failures++;
+			continue;
+		}
+		std::vector<float> samples;
+		render(scenario, goldenSeconds, goldenRate, &samples, NULL, NULL);
+		if (hashSamples(samples) == it->second) {
+			printf("%-24s exact\n", scenario->name.c_str());
+		}
+		else {
+			printf("%-24s FAILED, hash differs\n", scenario->name.c_str());
+			failures++;
+		}
+	}
+	printf("%d failed\n", failures);
+	return failures > 0 ? 1 : 0;
+}
+
+
+/** Passes `in` through a mono resampler in blocks of 32 frames and returns its output */
+static std::vector<float> resample(Resampler<1> &src, const std::vector<float> &in) {
+	std::vector<float> out;
+	float buffer[4 * 32];
+	for (size_t i = 0; i < in.size(); i += 32) {
+		int inFrames = std::min((int) (in.size() - i), 32);
+		int outFrames = 4 * 32;
+		src.process(&in[i], &inFrames, buffer, &outFrames);
+		out.insert(out.end(), buffer, buffer + outFrames);
+	}
+	return out;
+}
+
+/** Returns the level in dB at `outFreq` in the output of the resampler, fed with a unit sine at `inFreq`, skipping the filter's warm-up */
+static double measureLevel(ResamplerQuality quality, int inRate, int outRate, double inFreq, double outFreq) {
+	Resampler<1> src;
+	src.setRates(inRate, outRate);
+	src.setQuality(quality);
+	std::vector<float> in(inRate / 10);
+	for (size_t i = 0; i < in.size(); i++) {
+		in[i] = sin(2 * M_PI * inFreq * i / inRate);
+	}
+	std::vector<float> out = resample(src, in);
+	// Hann-windowed correlation, so the input tone doesn't leak into the level of an image next to it
+	size_t start = ResamplerFilter::MAX_TAPS * 2;
+	size_t n = out.size() - start;
+	double re = 0.0;
+	double im = 0.0;
+	double windowSum = 0.0;
+	for (size_t i = 0; i < n; i++) {
+		double w = 0.5 - 0.5 * cos(2 * M_PI * i / n);
+		double phase = 2 * M_PI * outFreq * (start + i) / outRate;
+		re += w * out[start + i] * cos(phase);
+		im += w * out[start + i] * sin(phase);
+		windowSum += w;
+	}
+	return 20.0 * log10(2.0 * sqrt(re * re + im * im) / windowSum);
+}
+
+/** Minimum rejection in dB at 1.1 times the slower Nyquist frequency, for each quality */
+static const double minRejection[NUM_RESAMPLER_QUALITIES] = {15.0, 22.0, 55.0};
+
+/** Reports the frequency response of each quality, and checks the rejection just above the slower Nyquist frequency.
+Returns nonzero if a rate pair rejects less than its quality's minimum.
+*/
+static int checkResampler() {
+	int failures = 0;
+	const int ratePairs[][2] = {{96000, 48000}, {48000, 96000}, {96000, 44100}, {48000, 32000}, {32000, 48000}};
+	// Ratios of the slower Nyquist frequency where aliases or images land, the first is the one checked
+	const double stopRatios[] = {1.1, 1.05, 1.2};
+	printf("%-32s %10s %10s %10s %10s\n", "resampler", "pass dB", "1.1x dB", "1.05x dB", "1.2x dB");
+	for (int quality = 0; quality < NUM_RESAMPLER_QUALITIES; quality++) {
+		for (const int *rates : ratePairs) {
+			int inRate = rates[0];
+			int outRate = rates[1];
+			std::string name = std::string(resamplerQualityNames[quality]) + "/" + std::to_string(inRate) + "-" + std::to_string(outRate);
+
+			// Passband at 40% of the slower Nyquist frequency
+			int slowRate = std::min(inRate, outRate);
+			double pass = measureLevel((ResamplerQuality) quality, inRate, outRate, 0.2 * slowRate, 0.2 * slowRate);
+			double stop[3];
+			for (int i = 0; i < 3; i++) {
+				// A tone above the output Nyquist frequency aliases to its mirror image when decimating.
+				// When interpolating, the input tone's image lands above the input Nyquist frequency.
+				double high = 0.5 * stopRatios[i] * slowRate;
+				double low = slowRate - high;
+				if (outRate < inRate)
+					stop[i] = measureLevel((ResamplerQuality) quality, inRate, outRate, high, low);
+				else
+					stop[i] = measureLevel((ResamplerQuality) quality, inRate, outRate, low, high);
+			}
+			bool failed = (-stop[0] < minRejection[quality]);
+			if (failed)
+				failures++;
+			printf("%-32s %10.2f %10.1f %10.1f %10.1f%s\n", name.c_str(), pass, stop[0], stop[1], stop[2], failed ? "  FAILED" : "");
+		}
+	}
+	printf("%d failed\n", failures);
+	return failures > 0 ? 1 : 0;
+}
+
+
+static void usage(const char *argv0) {
+	printf("Usage: %s [options]\n", argv0);
+	printf("  -s SECONDS  length of each render (default 10)\n");
+	printf("  -r RATE     host sample rate in Hz (default 48000)\n");
+	printf("  -m FILTER   only run scenarios whose name contains FILTER\n");
+	printf("  -l          list scenarios and exit\n");
+	printf("  -w DIR      record golden renders of the scenarios to DIR\n");
+	printf("  -c DIR      check the scenarios against the golden renders in DIR\n");
+	printf("  -b DB       minimum SNR of float renders that differ from the reference (default 90)\n");
+	printf("  -g FILE     record the hashes of the fixed-point renders to FILE\n");
+	printf("  -t FILE     check the fixed-point renders against the hashes in FILE\n");
+	printf("  -e          check the resampler's frequency response\n");
+}
+
+
+int main(int argc, char *argv[]) {
+	float seconds = 10.f;
+	float hostRate = 48000.f;
+	std::string filter;
+	bool list = false;
+	std::string recordDir;
+	std::string checkDir;
+	std::string recordHashesPath;
+	std::string checkHashesPath;
+	double minSnr = 90.0;
+	bool resamplerCheck = false;
+
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "-s" && i + 1 < argc) {
+			seconds = atof(argv[++i]);
+		}
+		else if (arg == "-r" && i + 1 < argc) {
+			hostRate = atof(argv[++i]);
+		}
+		else if (arg == "-m" && i + 1 < argc) {
+			filter = argv[++i];
+		}
+		else if (arg == "-l") {
+			list = true;
+		}
+		else if (arg == "-w" && i + 1 < argc) {
+			recordDir = argv[++i];
+		}
+		else if (arg == "-c" && i + 1 < argc) {
+			checkDir = argv[++i];
+		}
+		else if (arg == "-g" && i + 1 < argc) {
+			recordHashesPath = argv[++i];
+		}
+		else if (arg == "-t" && i + 1 < argc) {
+			checkHashesPath = argv[++i];
+		}
+		else if (arg == "-e") {
+			resamplerCheck = true;
+		}
+		else if (arg == "-b" && i + 1 < argc) {
+			minSnr = atof(argv[++i]);
+		}
+		else {
+			usage(argv[0]);
+			return (arg == "-h") ? 0 : 1;
+		}
+	}
+	if (seconds <= 0.f || hostRate <= 0.f) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	std::vector<Scenario*> scenarios;
+	createScenarios(scenarios);
+	std::vector<Scenario*> selected;
+	for (Scenario *scenario : scenarios) {
+		if (filter.empty() || scenario->name.find(filter) != std::string::npos)
+			selected.push_back(scenario);
+	}
+
+	int status = 0;
+	if (resamplerCheck) {
+		status = checkResampler();
+	}
+	else if (list) {
+		for (Scenario *scenario : selected) {
+			printf("%s\n", scenario->name.c_str());
+		}
+	}
+	else if (!recordDir.empty()) {
+		status = recordGolden(selected, recordDir);
+	}
+	else if (!checkDir.empty()) {
+		status = checkGolden(selected, checkDir, minSnr);
+	}
+	else if (!recordHashesPath.empty()) {
+		status = recordHashes(selected, recordHashesPath);
+	}
+	else if (!checkHashesPath.empty()) {
+		status = checkHashes(selected, checkHashesPath);
+	}
+	else {
+		printf("%g s at %g Hz, costs per host sample\n", seconds, hostRate);
+		printf("%-24s %10s %12s %12s\n", "scenario", "ns/sample", "x realtime", "peak us");
+		for (Scenario *scenario : selected) {
+			run(scenario, seconds, hostRate);
+		}
+	}
+
+	for (Scenario *scenario : scenarios) {
+		delete scenario;
+	}
+	return status;
+}
@@ -26,3 +26,54 @@ void init(rack::Plugin *p) {
 	//p->addModel(modelMarbles);
 	//p->addModel(modelStages);
 }
+
+
+struct ResamplerQualityItem : MenuItem {
+	ResamplerQuality *quality;
+	ResamplerQuality value;
+	void onAction(const ActionEvent &e) override {
+		*quality = value;
+	}
+	void step() override {
+		rightText = CHECKMARK(*quality == value);
+		MenuItem::step();
+	}
+};
+
+void appendResamplerQualityMenu(Menu *menu, ResamplerQuality *quality, std::function<float(ResamplerQuality)> latency) {
+	static const char *names[NUM_RESAMPLER_QUALITIES] = {
+		"Low latency",
+		"Balanced",
+		"High quality",
+	};
+
+	menu->addChild(construct<MenuLabel>());
+	menu->addChild(construct<MenuLabel>(&MenuLabel::text, "Resampling"));
+	for (int i = 0; i < NUM_RESAMPLER_QUALITIES; i++) {
+		std::string text = string::f("%s (%.2f ms)", names[i], latency((ResamplerQuality) i) * 1000.f);
+		menu->addChild(construct<ResamplerQualityItem>(&MenuItem::text, text, &ResamplerQualityItem::quality, quality, &ResamplerQualityItem::value, (ResamplerQuality) i));
+	}
+}
+
+
+struct DspTimerResetItem : MenuItem {
+	DspTimer *timer;
+	void onAction(const ActionEvent &e) override {
+		timer->reset();
+	}
+};
+
+void appendDspTimerMenu(Menu *menu, DspTimer *timer, float blockDuration) {
+	DspTimer::Stats stats = timer->getStats();
+
+	menu->addChild(construct<MenuLabel>());
+	menu->addChild(construct<MenuLabel>(&MenuLabel::text, "DSP time per block"));
+	if (stats.count > 0) {
+		menu->addChild(construct<MenuLabel>(&MenuLabel::text, string::f("Mean %.1f µs, p99 %.1f µs, max %.1f µs", stats.mean * 1e6f, stats.p99 * 1e6f, stats.max * 1e6f)));
+		menu->addChild(construct<MenuLabel>(&MenuLabel::text, string::f("%.0fx realtime over %llu blocks", blockDuration / stats.mean, (unsigned long long) stats.count)));
+	}
+	else {
+		menu->addChild(construct<MenuLabel>(&MenuLabel::text, "No blocks rendered"));
+	}
+	menu->addChild(construct<DspTimerResetItem>(&MenuItem::text, "Reset timing", &DspTimerResetItem::timer, timer));
+}
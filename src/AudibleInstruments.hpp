@@ -1,4 +1,6 @@
 #include "rack.hpp"
+#include "core/Resampler.hpp"
+#include "core/DspTimer.hpp"
 
 
 using namespace rack;
@@ -29,4 +31,39 @@ extern Model *modelFrames;
 extern Model *modelPeaks;
 extern Model *modelStages;
 extern Model *modelMarbles;
-*/
\ No newline at end of file
+*/
+
+
+/** Lights and meters are refreshed once every LIGHT_DIVISION frames, with a dsp::ClockDivider.
+Pass LIGHT_DIVISION as the `frames` argument of Light::setBrightnessSmooth() so the fall time doesn't change.
+*/
+static const int LIGHT_DIVISION = 32;
+
+/** Holds the extremes of a signal between light updates, so peaks shorter than LIGHT_DIVISION frames still reach the lights */
+struct LightPeak {
+	float pos = 0.f;
+	float neg = 0.f;
+
+	void process(float x) {
+		pos = fmaxf(pos, x);
+		neg = fminf(neg, x);
+	}
+	void reset() {
+		pos = 0.f;
+		neg = 0.f;
+	}
+	float getAbs() {
+		return fmaxf(pos, -neg);
+	}
+};
+
+
+/** Appends the resampling quality presets to a context menu.
+`latency` returns the latency in seconds the module would have with a given quality.
+*/
+void appendResamplerQualityMenu(Menu *menu, ResamplerQuality *quality, std::function<float(ResamplerQuality)> latency);
+
+/** Appends the render time statistics of a module to a context menu.
+`blockDuration` is the audio duration of one timed call in seconds, for the realtime factor.
+*/
+void appendDspTimerMenu(Menu *menu, DspTimer *timer, float blockDuration);
@@ -1,5 +1,6 @@
 #include "AudibleInstruments.hpp"
 #include <string.h>
+#include "core/BlindsEngine.hpp"
 
 
 struct Blinds : Module {
@@ -44,6 +45,9 @@ struct Blinds : Module {
 		NUM_LIGHTS
 	};
 
+	dsp::ClockDivider lightDivider;
+	LightPeak outPeaks[4];
+
 	Blinds() {
 		config(NUM_PARAMS, NUM_INPUTS, NUM_OUTPUTS, NUM_LIGHTS);
 
@@ -56,6 +60,8 @@ struct Blinds : Module {
 		params[Blinds::MOD2_PARAM].config(-1.0, 1.0, 0.0, "Mod2");
 		params[Blinds::MOD3_PARAM].config(-1.0, 1.0, 0.0, "Mod3");
 		params[Blinds::MOD4_PARAM].config(-1.0, 1.0, 0.0, "Mod4");
+
+		lightDivider.setDivision(LIGHT_DIVISION);
 	}
 	//void step() override;
 	void process(const ProcessArgs &args) override;
@@ -63,21 +69,30 @@ struct Blinds : Module {
 
 
 void Blinds::process(const ProcessArgs &args) {
-	float out = 0.0;
+	float gains[4];
+	float in[4];
+	bool connected[4];
+	for (int i = 0; i < 4; i++) {
+		gains[i] = BlindsEngine::getGain(params[GAIN1_PARAM + i].value, params[MOD1_PARAM + i].value, inputs[CV1_INPUT + i].value);
+		in[i] = inputs[IN1_INPUT + i].normalize(5.0);
+		connected[i] = outputs[OUT1_OUTPUT + i].active;
+	}
+	float out[4];
+	BlindsEngine::process(gains, in, connected, out);
 
+	bool lightUpdate = lightDivider.process();
 	for (int i = 0; i < 4; i++) {
-		float g = params[GAIN1_PARAM + i].value;
-		g += params[MOD1_PARAM + i].value * inputs[CV1_INPUT + i].value / 5.0;
-		g = clamp(g, -2.0f, 2.0f);
-		lights[CV1_POS_LIGHT + 2*i].setBrightnessSmooth(fmaxf(0.0, g));
-		lights[CV1_NEG_LIGHT + 2*i].setBrightnessSmooth(fmaxf(0.0, -g));
-		out += g * inputs[IN1_INPUT + i].normalize(5.0);
-		lights[OUT1_POS_LIGHT + 2*i].setBrightnessSmooth(fmaxf(0.0, out / 5.0));
-		lights[OUT1_NEG_LIGHT + 2*i].setBrightnessSmooth(fmaxf(0.0, -out / 5.0));
-		if (outputs[OUT1_OUTPUT + i].active) {
-			outputs[OUT1_OUTPUT + i].value = out;
-			out = 0.0;
+		float g = gains[i];
+		outPeaks[i].process(out[i] / 5.0);
+		if (lightUpdate) {
+			lights[CV1_POS_LIGHT + 2*i].setBrightnessSmooth(fmaxf(0.0, g), LIGHT_DIVISION);
+			lights[CV1_NEG_LIGHT + 2*i].setBrightnessSmooth(fmaxf(0.0, -g), LIGHT_DIVISION);
+			lights[OUT1_POS_LIGHT + 2*i].setBrightnessSmooth(outPeaks[i].pos, LIGHT_DIVISION);
+			lights[OUT1_NEG_LIGHT + 2*i].setBrightnessSmooth(-outPeaks[i].neg, LIGHT_DIVISION);
+			outPeaks[i].reset();
 		}
+		if (connected[i])
+			outputs[OUT1_OUTPUT + i].value = out[i];
 	}
 }
 
@@ -1,10 +1,9 @@
 #include <string.h>
 #include "AudibleInstruments.hpp"
-#include "dsp/resampler.hpp"
 #include "dsp/ringbuffer.hpp"
-#include "braids/macro_oscillator.h"
-#include "braids/vco_jitter_source.h"
-#include "braids/signature_waveshaper.h"
+#include "core/BraidsEngine.hpp"
+#include "core/IdleDetector.hpp"
+#include "core/QualityGovernor.hpp"
 
 
 struct Braids : Module {
@@ -31,32 +30,85 @@ struct Braids : Module {
 		NUM_OUTPUTS
 	};
 
-	braids::MacroOscillator osc;
-	braids::SettingsData settings;
-	braids::VcoJitterSource jitter_source;
-	braids::SignatureWaveshaper ws;
-
-	dsp::SampleRateConverter<1> src;
-	dsp::DoubleRingBuffer<dsp::Frame<1>, 256> outputBuffer;
-	bool lastTrig = false;
+	BraidsEngine engine;
+	DspTimer timer;
+	IdleDetector idle;
+	/** Controls of the previous block, any change wakes the engine */
+	BraidsEngine::Controls lastControls[BraidsEngine::MAX_VOICES];
+	bool struck = false;
+
+	int channels = 1;
+	/** Host frames since the last block was rendered, for timestamping triggers */
+	int blockFrames = 0;
+	/** Trigger edges of the next block at the internal rate */
+	uint8_t syncBuffer[BraidsEngine::MAX_VOICES][BraidsEngine::BLOCK_SIZE] = {};
+	int strikes[BraidsEngine::MAX_VOICES];
+	Resampler<BraidsEngine::MAX_VOICES> src;
+	dsp::DoubleRingBuffer<dsp::Frame<BraidsEngine::MAX_VOICES>, 256> outputBuffer;
+	bool lastTrig[BraidsEngine::MAX_VOICES] = {};
 	bool lowCpu = false;
+	/** Chord of the paraphonic mode, copied to the engine at block boundaries */
+	uint8_t chord = 0;
+	/** Internal rate when not in low CPU mode, in Hz */
+	int renderRate = BraidsEngine::SAMPLE_RATE;
+	/** Rate the resampler is set up for, changed at block boundaries */
+	int srcRate = 0;
+	/** Resampler banks of every render rate, so the audio thread can switch between them */
+	ResamplerBanks renderBanks[BraidsEngine::NUM_RENDER_RATES];
+	ResamplerQuality resamplerQuality = RESAMPLER_HIGH_QUALITY;
+
+	/** Lets the governor switch between full quality, the low latency resampler and low CPU mode */
+	bool autoQuality = false;
+	QualityGovernor governor;
+	QualityGovernor::Level level = QualityGovernor::LEVEL_FULL;
+	/** Level to switch to once the output has faded out */
+	QualityGovernor::Level nextLevel = QualityGovernor::LEVEL_FULL;
+	float switchGain = 1.f;
+	/** Whether the block playing now was rendered at the host rate */
+	bool blockLowCpu = false;
 
 	Braids();
 	void process(const ProcessArgs &args) override;
-	void setShape(int shape);
+
+	void onSampleRateChange() override {
+		for (int i = 0; i < BraidsEngine::NUM_RENDER_RATES; i++) {
+			renderBanks[i].setRates(BraidsEngine::renderRates[i], APP->engine->getSampleRate());
+		}
+		setRenderRate();
+	}
+
+	/** Switches the resampler to `renderRate`. Realtime-safe, since the banks are designed in onSampleRateChange(). */
+	void setRenderRate() {
+		srcRate = renderRate;
+		for (const ResamplerBanks &banks : renderBanks) {
+			if (banks.inRate == srcRate)
+				src.setBanks(banks);
+		}
+		// Sleep once a percussive shape has decayed for 100ms
+		idle.setHold(0.1f, BraidsEngine::BLOCK_SIZE, srcRate);
+		idle.fadeFrames = srcRate / 1000;
+	}
 
 	json_t *dataToJson() override {
 		json_t *rootJ = json_object();
 		json_t *settingsJ = json_array();
-		uint8_t *settingsArray = &settings.shape;
+		uint8_t *settingsArray = &engine.settings.shape;
 		for (int i = 0; i < 20; i++) {
 			json_t *settingJ = json_integer(settingsArray[i]);
 			json_array_insert_new(settingsJ, i, settingJ);
 		}
 		json_object_set_new(rootJ, "settings", settingsJ);
+		json_object_set_new(rootJ, "resolution", json_integer(engine.settings.resolution));
+		json_object_set_new(rootJ, "sampleRate", json_integer(engine.settings.sample_rate));
 
 		json_t *lowCpuJ = json_boolean(lowCpu);
 		json_object_set_new(rootJ, "lowCpu", lowCpuJ);
+		json_object_set_new(rootJ, "renderRate", json_integer(renderRate));
+		json_object_set_new(rootJ, "chord", json_integer(chord));
+
+		json_object_set_new(rootJ, "resamplerQuality", json_integer(resamplerQuality));
+		json_object_set_new(rootJ, "autoQuality", json_boolean(autoQuality));
+		json_object_set_new(rootJ, "floatPath", json_boolean(engine.floatPath));
 
 		return rootJ;
 	}
@@ -64,18 +116,67 @@ struct Braids : Module {
 	void dataFromJson(json_t *rootJ) override {
 		json_t *settingsJ = json_object_get(rootJ, "settings");
 		if (settingsJ) {
-			uint8_t *settingsArray = &settings.shape;
+			uint8_t *settingsArray = &engine.settings.shape;
 			for (int i = 0; i < 20; i++) {
 				json_t *settingJ = json_array_get(settingsJ, i);
 				if (settingJ)
 					settingsArray[i] = json_integer_value(settingJ);
 			}
 		}
+		// The AD settings have 16 steps, and ATTK and DECY index the envelope's tables, so keep edited or corrupted patches in range
+		for (uint8_t *setting : {&engine.settings.ad_attack, &engine.settings.ad_decay, &engine.settings.ad_fm, &engine.settings.ad_timbre, &engine.settings.ad_color}) {
+			*setting = clamp((int) *setting, 0, 15);
+		}
+
+		// Older patches saved zeros for these unsupported settings, which would mean 2 bits at 4 kHz
+		json_t *resolutionJ = json_object_get(rootJ, "resolution");
+		engine.settings.resolution = resolutionJ ? json_integer_value(resolutionJ) : (int) braids::RESOLUTION_16_BIT;
+		json_t *sampleRateJ = json_object_get(rootJ, "sampleRate");
+		engine.settings.sample_rate = sampleRateJ ? json_integer_value(sampleRateJ) : (int) braids::SAMPLE_RATE_96K;
 
 		json_t *lowCpuJ = json_object_get(rootJ, "lowCpu");
 		if (lowCpuJ) {
 			lowCpu = json_boolean_value(lowCpuJ);
 		}
+
+		json_t *renderRateJ = json_object_get(rootJ, "renderRate");
+		if (renderRateJ) {
+			int rate = json_integer_value(renderRateJ);
+			for (int r : BraidsEngine::renderRates) {
+				if (r == rate)
+					renderRate = rate;
+			}
+		}
+
+		json_t *chordJ = json_object_get(rootJ, "chord");
+		if (chordJ) {
+			chord = clamp((int) json_integer_value(chordJ), 0, BraidsEngine::NUM_CHORDS - 1);
+		}
+
+		json_t *resamplerQualityJ = json_object_get(rootJ, "resamplerQuality");
+		if (resamplerQualityJ) {
+			resamplerQuality = (ResamplerQuality) clamp((int) json_integer_value(resamplerQualityJ), 0, NUM_RESAMPLER_QUALITIES - 1);
+		}
+
+		json_t *autoQualityJ = json_object_get(rootJ, "autoQuality");
+		if (autoQualityJ) {
+			autoQuality = json_boolean_value(autoQualityJ);
+		}
+
+		json_t *floatPathJ = json_object_get(rootJ, "floatPath");
+		if (floatPathJ) {
+			engine.floatPath = json_boolean_value(floatPathJ);
+		}
+	}
+
+	/** Returns the duration of the blocks being rendered, which are at the host rate in low CPU mode */
+	float getBlockDuration() {
+		return (float) BraidsEngine::BLOCK_SIZE / (blockLowCpu ? APP->engine->getSampleRate() : srcRate);
+	}
+
+	/** Returns the latency of the output in seconds with the given resampler quality */
+	float getLatency(ResamplerQuality quality) {
+		return lowCpu ? 0.f : ResamplerFilter::getLatency(quality, renderRate, APP->engine->getSampleRate());
 	}
 };
 
@@ -91,169 +192,140 @@ Braids::Braids() {
 	params[Braids::MODULATION_PARAM].config(-1.0, 1.0, 0.0, "Modulation");
 	params[Braids::COLOR_PARAM].config(0.0, 1.0, 0.5, "Color");
 
-	memset(&osc, 0, sizeof(osc));
-	osc.Init();
-	memset(&jitter_source, 0, sizeof(jitter_source));
-	jitter_source.Init();
-	memset(&ws, 0, sizeof(ws));
-	ws.Init(0x0000);
-	memset(&settings, 0, sizeof(settings));
-
-	// List of supported settings
-	settings.meta_modulation = 0;
-	settings.vco_drift = 0;
-	settings.signature = 0;
+	for (int c = 0; c < BraidsEngine::MAX_VOICES; c++) {
+		strikes[c] = -1;
+	}
+	onSampleRateChange();
 }
 
 void Braids::process(const ProcessArgs &args) {
-	// Trigger
-	bool trig = inputs[TRIG_INPUT].getVoltage() >= 1.0;
-	if (!lastTrig && trig) {
-		osc.Strike();
-	}
-	lastTrig = trig;
+	int trigChannels = inputs[TRIG_INPUT].getChannels();
 
 	// Render frames
 	if (outputBuffer.empty()) {
-		float fm = params[FM_PARAM].getValue() * inputs[FM_INPUT].getVoltage();
+		uint64_t startTicks = dspTimerTicks();
+
+		// Quality changes wait until the output has faded out.
+		// The governor only runs with Auto quality and without manual low CPU, otherwise its share of the total load is withdrawn, so other instances don't react to a stale load.
+		bool governed = autoQuality && !lowCpu;
+		if (!governed && (level != QualityGovernor::LEVEL_FULL || governor.published != 0)) {
+			nextLevel = level = QualityGovernor::LEVEL_FULL;
+			governor.reset();
+		}
+		if (nextLevel != level && switchGain <= 0.f) {
+			level = nextLevel;
+			src.reset();
+		}
+		if (renderRate != srcRate) {
+			setRenderRate();
+			src.reset();
+		}
+		blockLowCpu = lowCpu || level == QualityGovernor::LEVEL_LOW;
+		engine.setSampleRate(blockLowCpu ? args.sampleRate : srcRate);
+
+		// Voices are allocated at block boundaries, following the pitch and trigger inputs.
+		// In chord mode each voice takes one oscillator per tone, so fewer voices fit.
+		engine.chord = chord;
+		channels = std::max(std::max(inputs[PITCH_INPUT].getChannels(), trigChannels), 1);
+		channels = std::min(channels, engine.getMaxVoices());
+		src.setChannels(channels);
+
+		BraidsEngine::Controls controls[BraidsEngine::MAX_VOICES];
+		bool changed = false;
+		for (int c = 0; c < channels; c++) {
+			controls[c].shape = params[SHAPE_PARAM].getValue();
+			controls[c].fm = params[FM_PARAM].getValue() * inputs[FM_INPUT].getPolyVoltage(c);
+			controls[c].timbre = params[TIMBRE_PARAM].getValue() + params[MODULATION_PARAM].getValue() * inputs[TIMBRE_INPUT].getPolyVoltage(c) / 5.0;
+			controls[c].color = params[COLOR_PARAM].getValue() + inputs[COLOR_INPUT].getPolyVoltage(c) / 5.0;
+			controls[c].pitch = inputs[PITCH_INPUT].getPolyVoltage(c) + params[COARSE_PARAM].getValue() + params[FINE_PARAM].getValue() / 12.0;
+			memcpy(controls[c].sync, syncBuffer[c], sizeof(controls[c].sync));
+			controls[c].strike = strikes[c];
+			changed |= memcmp(&controls[c], &lastControls[c], sizeof(controls[c])) != 0;
+			lastControls[c] = controls[c];
+		}
 
-		// Set shape
-		int shape = roundf(params[SHAPE_PARAM].getValue() * braids::MACRO_OSC_SHAPE_LAST_ACCESSIBLE_FROM_META);
-		if (settings.meta_modulation) {
-			shape += roundf(fm / 10.0 * braids::MACRO_OSC_SHAPE_LAST_ACCESSIBLE_FROM_META);
+		dsp::Frame<BraidsEngine::MAX_VOICES> in[BraidsEngine::BLOCK_SIZE] = {};
+		if (idle.wake(struck || changed)) {
+			timer.start();
+			for (int c = 0; c < channels; c++) {
+				engine.render(c, controls[c], &in[0].samples[c], BraidsEngine::MAX_VOICES);
+			}
+			timer.stop();
+			idle.process((float*) in, BraidsEngine::BLOCK_SIZE, BraidsEngine::MAX_VOICES);
 		}
-		settings.shape = clamp(shape, 0, braids::MACRO_OSC_SHAPE_LAST_ACCESSIBLE_FROM_META);
-
-		// Setup oscillator from settings
-		osc.set_shape((braids::MacroOscillatorShape) settings.shape);
-
-		// Set timbre/modulation
-		float timbre = params[TIMBRE_PARAM].getValue() + params[MODULATION_PARAM].getValue() * inputs[TIMBRE_INPUT].getVoltage() / 5.0;
-		float modulation = params[COLOR_PARAM].getValue() + inputs[COLOR_INPUT].getVoltage() / 5.0;
-		int16_t param1 = rescale(clamp(timbre, 0.0f, 1.0f), 0.0f, 1.0f, 0, INT16_MAX);
-		int16_t param2 = rescale(clamp(modulation, 0.0f, 1.0f), 0.0f, 1.0f, 0, INT16_MAX);
-		osc.set_parameters(param1, param2);
-
-		// Set pitch
-		float pitchV = inputs[PITCH_INPUT].getVoltage() + params[COARSE_PARAM].getValue() + params[FINE_PARAM].getValue() / 12.0;
-		if (!settings.meta_modulation)
-			pitchV += fm;
-		if (lowCpu)
-			pitchV += log2f(96000.f * args.sampleTime);
-		int32_t pitch = (pitchV * 12.0 + 60) * 128;
-		pitch += jitter_source.Render(settings.vco_drift);
-		pitch = clamp(pitch, 0, 16383);
-		osc.set_pitch(pitch);
-
-		// TODO: add a sync input buffer (must be sample rate converted)
-		uint8_t sync_buffer[24] = {};
-
-		int16_t render_buffer[24];
-		osc.Render(sync_buffer, render_buffer, 24);
-
-		// Signature waveshaping, decimation (not yet supported), and bit reduction (not yet supported)
-		uint16_t signature = settings.signature * settings.signature * 4095;
-		for (size_t i = 0; i < 24; i++) {
-			const int16_t bit_mask = 0xffff;
-			int16_t sample = render_buffer[i] & bit_mask;
-			int16_t warped = ws.Transform(sample);
-			render_buffer[i] = stmlib::Mix(sample, warped, signature);
+		struck = false;
+		memset(syncBuffer, 0, sizeof(syncBuffer));
+		for (int c = 0; c < BraidsEngine::MAX_VOICES; c++) {
+			strikes[c] = -1;
 		}
+		blockFrames = 0;
 
-		if (lowCpu) {
-			for (int i = 0; i < 24; i++) {
-				dsp::Frame<1> f;
-				f.samples[0] = render_buffer[i] / 32768.0;
-				outputBuffer.push(f);
+		if (blockLowCpu) {
+			for (int i = 0; i < BraidsEngine::BLOCK_SIZE; i++) {
+				outputBuffer.push(in[i]);
 			}
 		}
 		else {
-			// Sample rate convert
-			dsp::Frame<1> in[24];
-			for (int i = 0; i < 24; i++) {
-				in[i].samples[0] = render_buffer[i] / 32768.0;
-			}
-			src.setRates(96000, args.sampleRate);
+			// Sample rate convert all voices in one pass.
+			// Changing quality only swaps filter banks designed in onSampleRateChange(), so it's safe here.
+			src.setQuality(level == QualityGovernor::LEVEL_MEDIUM ? RESAMPLER_LOW_LATENCY : resamplerQuality);
 
-			int inLen = 24;
+			int inLen = BraidsEngine::BLOCK_SIZE;
 			int outLen = outputBuffer.capacity();
 			src.process(in, &inLen, outputBuffer.endData(), &outLen);
 			outputBuffer.endIncr(outLen);
 		}
+
+		if (governed) {
+			// The cost includes resampling, which is what the lower levels save
+			float seconds = outputBuffer.size() * args.sampleTime;
+			nextLevel = governor.process(dspTimerTicks() - startTicks, seconds, APP->engine->getThreadCount());
+		}
+	}
+
+	// Fade out before a quality change and back in after it, since the paths have different delays
+	float switchTarget = (nextLevel != level) ? 0.f : 1.f;
+	switchGain = clamp(switchTarget, switchGain - args.sampleTime / 2e-3f, switchGain + args.sampleTime / 2e-3f);
+
+	// Triggers are timestamped into the next block, at the position this frame has in the block playing now.
+	// Every edge is then delayed by exactly one block, rather than being rounded to the next block boundary.
+	float internalFrames = blockLowCpu ? 1.f : srcRate * args.sampleTime;
+	int offset = std::min((int) (blockFrames * internalFrames), BraidsEngine::BLOCK_SIZE - 1);
+	// A mono TRIG strikes every voice
+	for (int c = 0; c < channels; c++) {
+		bool trig = inputs[TRIG_INPUT].getPolyVoltage(c) >= 1.0;
+		if (!lastTrig[c] && trig) {
+			// The trigger also hard-syncs the oscillator, as on the hardware, unless the engine routes it to the envelope
+			syncBuffer[c][offset] = 1;
+			if (strikes[c] < 0)
+				strikes[c] = offset;
+			struck = true;
+		}
+		lastTrig[c] = trig;
 	}
+	blockFrames++;
 
 	// Output
 	if (!outputBuffer.empty()) {
-		dsp::Frame<1> f = outputBuffer.shift();
-		outputs[OUT_OUTPUT].setVoltage(5.0 * f.samples[0]);
+		dsp::Frame<BraidsEngine::MAX_VOICES> f = outputBuffer.shift();
+		outputs[OUT_OUTPUT].setChannels(channels);
+		for (int c = 0; c < channels; c++) {
+			outputs[OUT_OUTPUT].setVoltage(5.0 * switchGain * f.samples[c], c);
+		}
 	}
 }
 
 
-static const char *algo_values[] = {
-	"CSAW",
-	"/\\-_",
-	"//-_",
-	"FOLD",
-	"uuuu",
-	"SUB-",
-	"SUB/",
-	"SYN-",
-	"SYN/",
-	"//x3",
-	"-_x3",
-	"/\\x3",
-	"SIx3",
-	"RING",
-	"////",
-	"//uu",
-	"TOY*",
-	"ZLPF",
-	"ZPKF",
-	"ZBPF",
-	"ZHPF",
-	"VOSM",
-	"VOWL",
-	"VFOF",
-	"HARM",
-	"FM  ",
-	"FBFM",
-	"WTFM",
-	"PLUK",
-	"BOWD",
-	"BLOW",
-	"FLUT",
-	"BELL",
-	"DRUM",
-	"KICK",
-	"CYMB",
-	"SNAR",
-	"WTBL",
-	"WMAP",
-	"WLIN",
-	"WTx4",
-	"NOIS",
-	"TWNQ",
-	"CLKN",
-	"CLOU",
-	"PRTC",
-	"QPSK",
-	"    ",
-};
-
-struct BraidsDisplay : TransparentWidget {
-	Braids *module;
-	std::shared_ptr<Font> font;
+/** Returns the segment font, loaded once for every display */
+static std::shared_ptr<Font> getSegmentFont() {
+	static std::shared_ptr<Font> font = APP->window->loadFont(asset::plugin(pluginInstance, "res/hdad-segment14-1.002/Segment14.ttf"));
+	return font;
+}
 
-	BraidsDisplay() {
-		font = APP->window->loadFont(asset::plugin(pluginInstance, "res/hdad-segment14-1.002/Segment14.ttf"));
-	}
+struct BraidsDisplayText : TransparentWidget {
+	int shape = 0;
 
 	void draw(NVGcontext *vg) override {
-	    int shape = 0 ;
-	    if (module)
-		    shape = module->settings.shape;
-
 		// Background
 		NVGcolor backgroundColor = nvgRGB(0x38, 0x38, 0x38);
 		NVGcolor borderColor = nvgRGB(0x10, 0x10, 0x10);
@@ -266,7 +338,7 @@ struct BraidsDisplay : TransparentWidget {
 		nvgStroke(vg);
 
 		nvgFontSize(vg, 36);
-		nvgFontFaceId(vg, font->handle);
+		nvgFontFaceId(vg, getSegmentFont()->handle);
 		nvgTextLetterSpacing(vg, 2.5);
 
 		Vec textPos = Vec(10, 48);
@@ -274,7 +346,30 @@ struct BraidsDisplay : TransparentWidget {
 		nvgFillColor(vg, nvgTransRGBA(textColor, 16));
 		nvgText(vg, textPos.x, textPos.y, "~~~~", NULL);
 		nvgFillColor(vg, textColor);
-		nvgText(vg, textPos.x, textPos.y, algo_values[shape], NULL);
+		nvgText(vg, textPos.x, textPos.y, BraidsEngine::shapeNames[shape], NULL);
+	}
+};
+
+/** Caches the display in a framebuffer, which is only redrawn when the shape changes */
+struct BraidsDisplay : FramebufferWidget {
+	Braids *module;
+	BraidsDisplayText *text;
+
+	BraidsDisplay() {
+		text = new BraidsDisplayText();
+		addChild(text);
+	}
+
+	void step() override {
+		int shape = 0;
+		if (module)
+			shape = module->engine.settings.shape;
+		if (shape != text->shape || !text->box.size.isEqual(box.size)) {
+			text->shape = shape;
+			text->box.size = box.size;
+			dirty = true;
+		}
+		FramebufferWidget::step();
 	}
 };
 
@@ -293,6 +388,85 @@ struct BraidsSettingItem : MenuItem {
 	}
 };
 
+struct BraidsChoiceValueItem : MenuItem {
+	uint8_t *setting;
+	uint8_t value;
+	void onAction(const ActionEvent &e) override {
+		*setting = value;
+	}
+	void step() override {
+		rightText = CHECKMARK(*setting == value);
+		MenuItem::step();
+	}
+};
+
+/** Submenu choosing one value of a multi-valued setting */
+struct BraidsChoiceItem : MenuItem {
+	uint8_t *setting;
+	std::vector<std::string> labels;
+	Menu *createChildMenu() override {
+		Menu *menu = new Menu();
+		for (int i = 0; i < (int) labels.size(); i++) {
+			menu->addChild(construct<BraidsChoiceValueItem>(&MenuItem::text, labels[i], &BraidsChoiceValueItem::setting, setting, &BraidsChoiceValueItem::value, i));
+		}
+		return menu;
+	}
+	void step() override {
+		rightText = (*setting < labels.size()) ? labels[*setting] + " " + RIGHT_ARROW : RIGHT_ARROW;
+		MenuItem::step();
+	}
+};
+
+struct BraidsAutoQualityItem : MenuItem {
+	Braids *braids;
+	void onAction(const ActionEvent &e) override {
+		braids->autoQuality = !braids->autoQuality;
+	}
+	void step() override {
+		static const char *levelNames[QualityGovernor::NUM_LEVELS] = {"", "Medium ", "Low "};
+		rightText = braids->autoQuality ? std::string(levelNames[braids->level]) + "✔" : "";
+		MenuItem::step();
+	}
+};
+
+struct BraidsFloatPathItem : MenuItem {
+	Braids *braids;
+	void onAction(const ActionEvent &e) override {
+		braids->engine.floatPath = !braids->engine.floatPath;
+	}
+	void step() override {
+		rightText = CHECKMARK(braids->engine.floatPath);
+		MenuItem::step();
+	}
+};
+
+struct BraidsRenderRateValueItem : MenuItem {
+	Braids *braids;
+	int rate;
+	void onAction(const ActionEvent &e) override {
+		braids->renderRate = rate;
+	}
+	void step() override {
+		rightText = CHECKMARK(braids->renderRate == rate);
+		MenuItem::step();
+	}
+};
+
+struct BraidsRenderRateItem : MenuItem {
+	Braids *braids;
+	Menu *createChildMenu() override {
+		Menu *menu = new Menu();
+		for (int rate : BraidsEngine::renderRates) {
+			menu->addChild(construct<BraidsRenderRateValueItem>(&MenuItem::text, string::f("%d kHz", rate / 1000), &BraidsRenderRateValueItem::braids, braids, &BraidsRenderRateValueItem::rate, rate));
+		}
+		return menu;
+	}
+	void step() override {
+		rightText = string::f("%d kHz ", braids->renderRate / 1000) + RIGHT_ARROW;
+		MenuItem::step();
+	}
+};
+
 struct BraidsLowCpuItem : MenuItem {
 	Braids *braids;
 	void onAction(const ActionEvent &e) override {
@@ -347,10 +521,37 @@ struct BraidsWidget : ModuleWidget {
 
 		menu->addChild(construct<MenuLabel>());
 		menu->addChild(construct<MenuLabel>(&MenuLabel::text, "Options"));
-		menu->addChild(construct<BraidsSettingItem>(&MenuItem::text, "META", &BraidsSettingItem::setting, &braids->settings.meta_modulation));
-		menu->addChild(construct<BraidsSettingItem>(&MenuItem::text, "DRFT", &BraidsSettingItem::setting, &braids->settings.vco_drift, &BraidsSettingItem::onValue, 4));
-		menu->addChild(construct<BraidsSettingItem>(&MenuItem::text, "SIGN", &BraidsSettingItem::setting, &braids->settings.signature, &BraidsSettingItem::onValue, 4));
+		menu->addChild(construct<BraidsSettingItem>(&MenuItem::text, "META", &BraidsSettingItem::setting, &braids->engine.settings.meta_modulation));
+		menu->addChild(construct<BraidsSettingItem>(&MenuItem::text, "DRFT", &BraidsSettingItem::setting, &braids->engine.settings.vco_drift, &BraidsSettingItem::onValue, 4));
+		menu->addChild(construct<BraidsSettingItem>(&MenuItem::text, "SIGN", &BraidsSettingItem::setting, &braids->engine.settings.signature, &BraidsSettingItem::onValue, 4));
+		menu->addChild(construct<BraidsChoiceItem>(&MenuItem::text, "BITS", &BraidsChoiceItem::setting, &braids->engine.settings.resolution, &BraidsChoiceItem::labels, std::vector<std::string>{"2 BIT", "3 BIT", "4 BIT", "6 BIT", "8 BIT", "12 B", "16 B"}));
+		menu->addChild(construct<BraidsChoiceItem>(&MenuItem::text, "RATE", &BraidsChoiceItem::setting, &braids->engine.settings.sample_rate, &BraidsChoiceItem::labels, std::vector<std::string>{"4K", "8K", "16K", "24K", "32K", "48K", "96K"}));
+		menu->addChild(construct<BraidsChoiceItem>(&MenuItem::text, "SCAL", &BraidsChoiceItem::setting, &braids->engine.settings.quantizer_scale, &BraidsChoiceItem::labels, std::vector<std::string>(BraidsEngine::scaleNames, BraidsEngine::scaleNames + BraidsEngine::NUM_SCALES)));
+		menu->addChild(construct<BraidsChoiceItem>(&MenuItem::text, "ROOT", &BraidsChoiceItem::setting, &braids->engine.settings.quantizer_root, &BraidsChoiceItem::labels, std::vector<std::string>(BraidsEngine::rootNames, BraidsEngine::rootNames + 12)));
+
+		// Envelope times and amounts take the firmware's 16 steps
+		std::vector<std::string> steps;
+		for (int i = 0; i < 16; i++) {
+			steps.push_back(std::to_string(i));
+		}
+		menu->addChild(construct<BraidsChoiceItem>(&MenuItem::text, "ATTK", &BraidsChoiceItem::setting, &braids->engine.settings.ad_attack, &BraidsChoiceItem::labels, steps));
+		menu->addChild(construct<BraidsChoiceItem>(&MenuItem::text, "DECY", &BraidsChoiceItem::setting, &braids->engine.settings.ad_decay, &BraidsChoiceItem::labels, steps));
+		menu->addChild(construct<BraidsChoiceItem>(&MenuItem::text, "AD FM", &BraidsChoiceItem::setting, &braids->engine.settings.ad_fm, &BraidsChoiceItem::labels, steps));
+		menu->addChild(construct<BraidsChoiceItem>(&MenuItem::text, "AD TIMBRE", &BraidsChoiceItem::setting, &braids->engine.settings.ad_timbre, &BraidsChoiceItem::labels, steps));
+		menu->addChild(construct<BraidsChoiceItem>(&MenuItem::text, "AD COLOR", &BraidsChoiceItem::setting, &braids->engine.settings.ad_color, &BraidsChoiceItem::labels, steps));
+		menu->addChild(construct<BraidsSettingItem>(&MenuItem::text, "AD VCA", &BraidsSettingItem::setting, &braids->engine.settings.ad_vca));
+
+		menu->addChild(construct<BraidsChoiceItem>(&MenuItem::text, "Chord", &BraidsChoiceItem::setting, &braids->chord, &BraidsChoiceItem::labels, std::vector<std::string>(BraidsEngine::chordNames, BraidsEngine::chordNames + BraidsEngine::NUM_CHORDS)));
+		menu->addChild(construct<BraidsFloatPathItem>(&MenuItem::text, "Float processing", &BraidsFloatPathItem::braids, braids));
+		menu->addChild(construct<BraidsRenderRateItem>(&MenuItem::text, "Internal rate", &BraidsRenderRateItem::braids, braids));
 		menu->addChild(construct<BraidsLowCpuItem>(&MenuItem::text, "Low CPU", &BraidsLowCpuItem::braids, braids));
+		menu->addChild(construct<BraidsAutoQualityItem>(&MenuItem::text, "Auto quality", &BraidsAutoQualityItem::braids, braids));
+
+		appendResamplerQualityMenu(menu, &braids->resamplerQuality, [=](ResamplerQuality quality) {
+			return braids->getLatency(quality);
+		});
+
+		appendDspTimerMenu(menu, &braids->timer, braids->getBlockDuration());
 	}
 };
 
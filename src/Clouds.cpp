@@ -1,11 +1,126 @@
 #include <string.h>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <memory>
+#include <vector>
+#include <algorithm>
 #include "AudibleInstruments.hpp"
-#include "dsp/resampler.hpp"
 #include "dsp/ringbuffer.hpp"
 #include "dsp/digital.hpp"
 #include "dsp/vumeter.hpp"
-#include "clouds/dsp/granular_processor.h"
-#include <iostream>
+#include "core/CloudsEngine.hpp"
+#include "core/IdleDetector.hpp"
+
+
+/** Memory handed between one module's audio thread and the memory worker */
+struct CloudsMemorySlot {
+	/** Settings of the memory the audio thread is waiting for, packed with packRequest(), or 0 */
+	std::atomic<uint64_t> request{0};
+	/** Memory created by the worker, taken by the audio thread at a block boundary */
+	std::atomic<CloudsMemory*> pendingMemory{NULL};
+	/** Memory the audio thread has let go of, destroyed by the worker */
+	std::atomic<CloudsMemory*> retiredMemory{NULL};
+
+	~CloudsMemorySlot() {
+		CloudsMemory::destroy(pendingMemory.exchange(NULL));
+		CloudsMemory::destroy(retiredMemory.exchange(NULL));
+	}
+
+	/** Packs memory settings into one word, so the audio thread can pass a consistent snapshot without a lock */
+	static uint64_t packRequest(size_t len, int quality, clouds::PlaybackMode playback) {
+		return (uint64_t) len << 8 | (quality & 0xf) << 4 | (playback & 0xf);
+	}
+
+	/** Called from the worker */
+	void update() {
+		CloudsMemory::destroy(retiredMemory.exchange(NULL));
+		uint64_t request = this->request.exchange(0);
+		if (!request)
+			return;
+		CloudsMemory *memory = CloudsMemory::create(request >> 8, (request >> 4) & 0xf, (clouds::PlaybackMode) (request & 0xf));
+		// Replace memory the audio thread hasn't taken yet
+		CloudsMemory::destroy(pendingMemory.exchange(memory));
+	}
+};
+
+
+/** One thread shared by every Clouds instance, creating and destroying their memory when woken.
+It runs while at least one instance exists, so settings changes don't depend on the panel being open, as when running headless.
+*/
+struct CloudsMemoryWorker {
+	std::mutex mutex;
+	std::condition_variable cv;
+	/** Held while the thread is started or joined, so an instance added meanwhile doesn't replace a thread still running */
+	std::mutex threadMutex;
+	std::thread thread;
+	/** The worker keeps a reference, so a module can be removed while its memory is being created */
+	std::vector<std::shared_ptr<CloudsMemorySlot>> slots;
+	/** Copy of `slots` updated by the thread, which keeps its capacity so the copy doesn't allocate under the lock */
+	std::vector<std::shared_ptr<CloudsMemorySlot>> updating;
+	bool woken = false;
+	bool running = false;
+
+	void add(std::shared_ptr<CloudsMemorySlot> slot) {
+		std::lock_guard<std::mutex> threadLock(threadMutex);
+		std::lock_guard<std::mutex> lock(mutex);
+		slots.push_back(slot);
+		if (!running) {
+			running = true;
+			thread = std::thread([this]() {
+				run();
+			});
+		}
+	}
+
+	void remove(std::shared_ptr<CloudsMemorySlot> slot) {
+		std::lock_guard<std::mutex> threadLock(threadMutex);
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			slots.erase(std::remove(slots.begin(), slots.end(), slot), slots.end());
+			if (!slots.empty())
+				return;
+			running = false;
+		}
+		// Returns once the worker finishes the memory it may be creating
+		cv.notify_one();
+		thread.join();
+	}
+
+	/** The lock is only held to set or take the flag and copy the slots, never while memory is created, so the audio thread can call this */
+	void wake() {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			woken = true;
+		}
+		cv.notify_one();
+	}
+
+	void run() {
+		std::unique_lock<std::mutex> lock(mutex);
+		while (true) {
+			cv.wait(lock, [this]() {
+				return woken || !running;
+			});
+			if (!running)
+				break;
+			woken = false;
+			updating.reserve(slots.capacity());
+			updating = slots;
+			lock.unlock();
+			for (std::shared_ptr<CloudsMemorySlot> &slot : updating) {
+				slot->update();
+			}
+			// Slots of removed instances are destroyed here, with any memory left in them
+			updating.clear();
+			lock.lock();
+		}
+	}
+};
+
+static CloudsMemoryWorker memoryWorker;
+
 
 struct Clouds : Module {
 	enum ParamIds {
@@ -51,44 +166,67 @@ struct Clouds : Module {
 		NUM_LIGHTS
 	};
 
-	dsp::SampleRateConverter<2> inputSrc;
-	dsp::SampleRateConverter<2> outputSrc;
+	Resampler<2> inputSrc;
+	Resampler<2> outputSrc;
+	ResamplerQuality resamplerQuality = RESAMPLER_HIGH_QUALITY;
+	/** Runs the processor at the host rate instead of converting to and from 32 kHz */
+	bool nativeRate = false;
+	/** Whether the engine is set up for the native rate, changed at block boundaries */
+	bool engineNativeRate = false;
 	dsp::DoubleRingBuffer<dsp::Frame<2>, 256> inputBuffer;
 	dsp::DoubleRingBuffer<dsp::Frame<2>, 256> outputBuffer;
 
-	uint8_t *block_mem;
-	uint8_t *block_ccm;
-	clouds::GranularProcessor *processor;
+	CloudsEngine engine;
+	std::shared_ptr<CloudsMemorySlot> memorySlot = std::make_shared<CloudsMemorySlot>();
+	/** Last request passed to the worker by the audio thread, cleared once the memory fits the settings again */
+	uint64_t memoryRequest = 0;
+	DspTimer timer;
+	IdleDetector idle;
 
 	bool triggered = false;
+	bool freezeLight = false;
+
+	dsp::ClockDivider lightDivider;
+	LightPeak inputPeak;
+	LightPeak outputPeak;
 
 	dsp::SchmittTrigger freezeTrigger;
 	bool freeze = false;
 	dsp::SchmittTrigger blendTrigger;
 	int blendMode = 0;
 
-	clouds::PlaybackMode playback;
-	int quality = 0;
-
 	Clouds();
 	~Clouds();
 
 	void process(const ProcessArgs &args) override;
+	void updateMemory();
+
+	void onSampleRateChange() override {
+		int sampleRate = APP->engine->getSampleRate();
+		inputSrc.setRates(sampleRate, CloudsEngine::SAMPLE_RATE);
+		outputSrc.setRates(CloudsEngine::SAMPLE_RATE, sampleRate);
+		engineNativeRate = nativeRate;
+		engine.setSampleRate(nativeRate ? sampleRate : CloudsEngine::SAMPLE_RATE);
+		idle.fadeFrames = engine.sampleRate / 1000;
+	}
 
 	void onReset() override {
 		freeze = false;
 		blendMode = 0;
-		playback = clouds::PLAYBACK_MODE_GRANULAR;
-		quality = 0;
+		engine.playback = clouds::PLAYBACK_MODE_GRANULAR;
+		engine.quality = 0;
 	}
 
 
 	json_t *dataToJson() override {
 		json_t *rootJ = json_object();
 
-		json_object_set_new(rootJ, "playback", json_integer((int) playback));
-		json_object_set_new(rootJ, "quality", json_integer(quality));
+		json_object_set_new(rootJ, "playback", json_integer((int) engine.playback));
+		json_object_set_new(rootJ, "quality", json_integer(engine.quality));
 		json_object_set_new(rootJ, "blendMode", json_integer(blendMode));
+		json_object_set_new(rootJ, "resamplerQuality", json_integer(resamplerQuality));
+		json_object_set_new(rootJ, "nativeRate", json_boolean(nativeRate));
+		json_object_set_new(rootJ, "duration", json_real(engine.duration));
 
 		return rootJ;
 	}
@@ -97,18 +235,42 @@ struct Clouds : Module {
 	void dataFromJson(json_t *rootJ) override {
 		json_t *playbackJ = json_object_get(rootJ, "playback");
 		if (playbackJ) {
-			playback = (clouds::PlaybackMode) json_integer_value(playbackJ);
+			engine.playback = (clouds::PlaybackMode) json_integer_value(playbackJ);
 		}
 
 		json_t *qualityJ = json_object_get(rootJ, "quality");
 		if (qualityJ) {
-			quality = json_integer_value(qualityJ);
+			engine.quality = json_integer_value(qualityJ);
 		}
 
 		json_t *blendModeJ = json_object_get(rootJ, "blendMode");
 		if (blendModeJ) {
 			blendMode = json_integer_value(blendModeJ);
 		}
+
+		json_t *resamplerQualityJ = json_object_get(rootJ, "resamplerQuality");
+		if (resamplerQualityJ) {
+			resamplerQuality = (ResamplerQuality) clamp((int) json_integer_value(resamplerQualityJ), 0, NUM_RESAMPLER_QUALITIES - 1);
+		}
+
+		json_t *nativeRateJ = json_object_get(rootJ, "nativeRate");
+		if (nativeRateJ) {
+			nativeRate = json_boolean_value(nativeRateJ);
+		}
+
+		json_t *durationJ = json_object_get(rootJ, "duration");
+		if (durationJ) {
+			engine.duration = clamp((float) json_number_value(durationJ), 0.f, 60.f);
+		}
+	}
+
+	/** Returns the latency of the input to output path in seconds with the given resampler quality */
+	float getLatency(ResamplerQuality quality) {
+		int sampleRate = APP->engine->getSampleRate();
+		// At the host rate, the output waits for a full block of input
+		if (nativeRate)
+			return (float) CloudsEngine::BLOCK_SIZE / sampleRate;
+		return ResamplerFilter::getLatency(quality, sampleRate, CloudsEngine::SAMPLE_RATE) + ResamplerFilter::getLatency(quality, CloudsEngine::SAMPLE_RATE, sampleRate);
 	}
 };
 
@@ -131,22 +293,40 @@ Clouds::Clouds(){
 	params[MODE_PARAM].config(0.0, 1.0, 0.0, "Mode");
 	params[LOAD_PARAM].config(0.0, 1.0, 0.0, "Load");
 
+	lightDivider.setDivision(LIGHT_DIVISION);
 
-	const int memLen = 118784;
-	const int ccmLen = 65536 - 128;
-	block_mem = new uint8_t[memLen]();
-	block_ccm = new uint8_t[ccmLen]();
-	processor = new clouds::GranularProcessor();
-	memset(processor, 0, sizeof(*processor));
-
-	processor->Init(block_mem, memLen, block_ccm, ccmLen);
 	onReset();
+	onSampleRateChange();
+	memoryWorker.add(memorySlot);
 }
 
 Clouds::~Clouds() {
-	delete processor;
-	delete[] block_mem;
-	delete[] block_ccm;
+	memoryWorker.remove(memorySlot);
+}
+
+/** Called from the audio thread at a block boundary. Asks the worker for memory fitting the current settings, and takes it once ready. */
+void Clouds::updateMemory() {
+	// Take new memory, unless the old one is still waiting to be destroyed
+	if (!memorySlot->retiredMemory.load()) {
+		CloudsMemory *memory = memorySlot->pendingMemory.exchange(NULL);
+		if (memory) {
+			// Memory created for settings that have changed since is freed instead
+			bool fits = engine.needsMemory() && engine.fits(memory->len, memory->quality, memory->playback);
+			memorySlot->retiredMemory = fits ? engine.swapMemory(memory) : memory;
+			memoryWorker.wake();
+		}
+	}
+
+	if (!engine.needsMemory()) {
+		memoryRequest = 0;
+		return;
+	}
+	uint64_t request = CloudsMemorySlot::packRequest(engine.getMemoryLength(), engine.quality, engine.playback);
+	if (request != memoryRequest) {
+		memoryRequest = request;
+		memorySlot->request = request;
+		memoryWorker.wake();
+	}
 }
 
 void Clouds::process(const ProcessArgs &args) {
@@ -170,80 +350,93 @@ void Clouds::process(const ProcessArgs &args) {
 		triggered = true;
 	}
 
+	if (nativeRate != engineNativeRate) {
+		onSampleRateChange();
+		inputBuffer.clear();
+		outputBuffer.clear();
+	}
+
 	// Render frames
-	if (outputBuffer.empty()) {
-		clouds::ShortFrame input[32] = {};
-		// Convert input buffer
-		{
-			inputSrc.setRates(args.sampleRate, 32000);
-			dsp::Frame<2> inputFrames[32];
+	// At the native rate, wait for a full block of input, which delays the output by one block
+	if (outputBuffer.empty() && (!nativeRate || inputBuffer.size() >= CloudsEngine::BLOCK_SIZE)) {
+		dsp::Frame<2> input[CloudsEngine::BLOCK_SIZE] = {};
+		if (nativeRate) {
+			memcpy(input, inputBuffer.startData(), sizeof(input));
+			inputBuffer.startIncr(CloudsEngine::BLOCK_SIZE);
+		}
+		else {
+			// Convert input buffer
+			inputSrc.setQuality(resamplerQuality);
 			int inLen = inputBuffer.size();
-			int outLen = 32;
-			inputSrc.process(inputBuffer.startData(), &inLen, inputFrames, &outLen);
-			inputBuffer.startIncr(inLen);
-
+			int outLen = CloudsEngine::BLOCK_SIZE;
 			// We might not fill all of the input buffer if there is a deficiency, but this cannot be avoided due to imprecisions between the input and output SRC.
-			for (int i = 0; i < outLen; i++) {
-				input[i].l = clamp(inputFrames[i].samples[0] * 32767.0f, -32768.0f, 32767.0f);
-				input[i].r = clamp(inputFrames[i].samples[1] * 32767.0f, -32768.0f, 32767.0f);
-			}
+			inputSrc.process(inputBuffer.startData(), &inLen, input, &outLen);
+			inputBuffer.startIncr(inLen);
 		}
 
+		updateMemory();
+
 		// Set up processor
-		processor->set_playback_mode(playback);
-		processor->set_quality(quality);
-		processor->Prepare();
-
-		clouds::Parameters *p = processor->mutable_parameters();
-		p->trigger = triggered;
-		p->gate = triggered;
-		p->freeze = freeze || (inputs[FREEZE_INPUT].getVoltage() >= 1.0);
-		p->position = clamp(params[POSITION_PARAM].getValue() + inputs[POSITION_INPUT].getVoltage() / 5.0f, 0.0f, 1.0f);
-		p->size = clamp(params[SIZE_PARAM].getValue() + inputs[SIZE_INPUT].getVoltage() / 5.0f, 0.0f, 1.0f);
-		p->pitch = clamp((params[PITCH_PARAM].getValue() + inputs[PITCH_INPUT].getVoltage()) * 12.0f, -48.0f, 48.0f);
-		p->density = clamp(params[DENSITY_PARAM].getValue() + inputs[DENSITY_INPUT].getVoltage() / 5.0f, 0.0f, 1.0f);
-		p->texture = clamp(params[TEXTURE_PARAM].getValue() + inputs[TEXTURE_INPUT].getVoltage() / 5.0f, 0.0f, 1.0f);
-		p->dry_wet = params[BLEND_PARAM].getValue();
-		p->stereo_spread = params[SPREAD_PARAM].getValue();
-		p->feedback = params[FEEDBACK_PARAM].getValue();
+		CloudsEngine::Controls controls;
+		controls.trigger = triggered;
+		controls.freeze = freeze || (inputs[FREEZE_INPUT].getVoltage() >= 1.0);
+		controls.position = clamp(params[POSITION_PARAM].getValue() + inputs[POSITION_INPUT].getVoltage() / 5.0f, 0.0f, 1.0f);
+		controls.size = clamp(params[SIZE_PARAM].getValue() + inputs[SIZE_INPUT].getVoltage() / 5.0f, 0.0f, 1.0f);
+		controls.pitch = clamp((params[PITCH_PARAM].getValue() + inputs[PITCH_INPUT].getVoltage()) * 12.0f, -48.0f, 48.0f);
+		controls.density = clamp(params[DENSITY_PARAM].getValue() + inputs[DENSITY_INPUT].getVoltage() / 5.0f, 0.0f, 1.0f);
+		controls.texture = clamp(params[TEXTURE_PARAM].getValue() + inputs[TEXTURE_INPUT].getVoltage() / 5.0f, 0.0f, 1.0f);
+		controls.dryWet = params[BLEND_PARAM].getValue();
+		controls.spread = params[SPREAD_PARAM].getValue();
+		controls.feedback = params[FEEDBACK_PARAM].getValue();
 		// TODO
 		// Why doesn't dry audio get reverbed?
-		p->reverb = params[REVERB_PARAM].getValue();
+		controls.reverb = params[REVERB_PARAM].getValue();
 		float blend = inputs[BLEND_INPUT].getVoltage() / 5.0f;
 		switch (blendMode) {
 			case 0:
-				p->dry_wet += blend;
-				p->dry_wet = clamp(p->dry_wet, 0.0f, 1.0f);
+				controls.dryWet += blend;
+				controls.dryWet = clamp(controls.dryWet, 0.0f, 1.0f);
 				break;
 			case 1:
-				p->stereo_spread += blend;
-				p->stereo_spread = clamp(p->stereo_spread, 0.0f, 1.0f);
+				controls.spread += blend;
+				controls.spread = clamp(controls.spread, 0.0f, 1.0f);
 				break;
 			case 2:
-				p->feedback += blend;
-				p->feedback = clamp(p->feedback, 0.0f, 1.0f);
+				controls.feedback += blend;
+				controls.feedback = clamp(controls.feedback, 0.0f, 1.0f);
 				break;
 			case 3:
-				p->reverb += blend;
-				p->reverb = clamp(p->reverb, 0.0f, 1.0f);
+				controls.reverb += blend;
+				controls.reverb = clamp(controls.reverb, 0.0f, 1.0f);
 				break;
 		}
+		freezeLight = controls.freeze;
 
-		clouds::ShortFrame output[32];
-		processor->Process(input, output, 32);
+		float inputPeak = 0.f;
+		for (int i = 0; i < CloudsEngine::BLOCK_SIZE; i++) {
+			inputPeak = fmaxf(inputPeak, fmaxf(fabsf(input[i].samples[0]), fabsf(input[i].samples[1])));
+		}
 
-		// Convert output buffer
-		{
-			dsp::Frame<2> outputFrames[32];
-			for (int i = 0; i < 32; i++) {
-				outputFrames[i].samples[0] = output[i].l / 32768.0;
-				outputFrames[i].samples[1] = output[i].r / 32768.0;
-			}
+		// Only sleep once silence has filled the whole recording buffer and the tails have decayed, and never while frozen
+		idle.setHold(engine.getBufferDuration() + 1.f, CloudsEngine::BLOCK_SIZE, engine.sampleRate);
+		dsp::Frame<2> output[CloudsEngine::BLOCK_SIZE] = {};
+		if (idle.wake(controls.freeze || controls.trigger || inputPeak >= idle.threshold)) {
+			timer.start();
+			engine.process(controls, (const float*) input, (float*) output);
+			timer.stop();
+			idle.process((float*) output, CloudsEngine::BLOCK_SIZE, 2);
+		}
 
-			outputSrc.setRates(32000, args.sampleRate);
-			int inLen = 32;
+		if (nativeRate) {
+			memcpy(outputBuffer.endData(), output, sizeof(output));
+			outputBuffer.endIncr(CloudsEngine::BLOCK_SIZE);
+		}
+		else {
+			// Convert output buffer
+			outputSrc.setQuality(resamplerQuality);
+			int inLen = CloudsEngine::BLOCK_SIZE;
 			int outLen = outputBuffer.capacity();
-			outputSrc.process(outputFrames, &inLen, outputBuffer.endData(), &outLen);
+			outputSrc.process(output, &inLen, outputBuffer.endData(), &outLen);
 			outputBuffer.endIncr(outLen);
 		}
 
@@ -259,20 +452,26 @@ void Clouds::process(const ProcessArgs &args) {
 	}
 
 	// Lights
-	clouds::Parameters *p = processor->mutable_parameters();
-	dsp::VuMeter vuMeter;
-	vuMeter.dBInterval = 6.0;
-	dsp::Frame<2> lightFrame = p->freeze ? outputFrame : inputFrame;
-	vuMeter.setValue(fmaxf(fabsf(lightFrame.samples[0]), fabsf(lightFrame.samples[1])));
-	lights[FREEZE_LIGHT].setBrightness(p->freeze ? 0.75 : 0.0);
-	lights[MIX_GREEN_LIGHT].setBrightnessSmooth(vuMeter.getBrightness(3));
-	lights[PAN_GREEN_LIGHT].setBrightnessSmooth(vuMeter.getBrightness(2));
-	lights[FEEDBACK_GREEN_LIGHT].setBrightnessSmooth(vuMeter.getBrightness(1));
-	lights[REVERB_GREEN_LIGHT].setBrightness(0.0);
-	lights[MIX_RED_LIGHT].setBrightness(0.0);
-	lights[PAN_RED_LIGHT].setBrightness(0.0);
-	lights[FEEDBACK_RED_LIGHT].setBrightnessSmooth(vuMeter.getBrightness(1));
-	lights[REVERB_RED_LIGHT].setBrightnessSmooth(vuMeter.getBrightness(0));
+	inputPeak.process(inputFrame.samples[0]);
+	inputPeak.process(inputFrame.samples[1]);
+	outputPeak.process(outputFrame.samples[0]);
+	outputPeak.process(outputFrame.samples[1]);
+	if (lightDivider.process()) {
+		dsp::VuMeter vuMeter;
+		vuMeter.dBInterval = 6.0;
+		vuMeter.setValue(freezeLight ? outputPeak.getAbs() : inputPeak.getAbs());
+		lights[FREEZE_LIGHT].setBrightness(freezeLight ? 0.75 : 0.0);
+		lights[MIX_GREEN_LIGHT].setBrightnessSmooth(vuMeter.getBrightness(3), LIGHT_DIVISION);
+		lights[PAN_GREEN_LIGHT].setBrightnessSmooth(vuMeter.getBrightness(2), LIGHT_DIVISION);
+		lights[FEEDBACK_GREEN_LIGHT].setBrightnessSmooth(vuMeter.getBrightness(1), LIGHT_DIVISION);
+		lights[REVERB_GREEN_LIGHT].setBrightness(0.0);
+		lights[MIX_RED_LIGHT].setBrightness(0.0);
+		lights[PAN_RED_LIGHT].setBrightness(0.0);
+		lights[FEEDBACK_RED_LIGHT].setBrightnessSmooth(vuMeter.getBrightness(1), LIGHT_DIVISION);
+		lights[REVERB_RED_LIGHT].setBrightnessSmooth(vuMeter.getBrightness(0), LIGHT_DIVISION);
+		inputPeak.reset();
+		outputPeak.reset();
+	}
 }
 
 
@@ -302,7 +501,7 @@ struct CloudsPlaybackItem : MenuItem {
 	Clouds *module;
 	clouds::PlaybackMode playback;
 	void onAction(const ActionEvent &e) override {
-		module->playback = playback;
+		module->engine.playback = playback;
 	}
 	void step() override {
 		//rightText = (module->playback == playback) ? "✔" : "";
@@ -315,7 +514,7 @@ struct CloudsQualityItem : MenuItem {
 	Clouds *module;
 	int quality;
 	void onAction(const ActionEvent &e) override {
-		module->quality = quality;
+		module->engine.quality = quality;
 	}
 	void step() override {
 		//rightText = (module->quality == quality) ? "✔" : "";
@@ -323,6 +522,29 @@ struct CloudsQualityItem : MenuItem {
 	}
 };
 
+struct CloudsDurationItem : MenuItem {
+	Clouds *module;
+	float duration;
+	void onAction(const ActionEvent &e) override {
+		module->engine.duration = duration;
+	}
+	void step() override {
+		rightText = CHECKMARK(module->engine.duration == duration);
+		MenuItem::step();
+	}
+};
+
+struct CloudsNativeRateItem : MenuItem {
+	Clouds *module;
+	void onAction(const ActionEvent &e) override {
+		module->nativeRate ^= true;
+	}
+	void step() override {
+		rightText = CHECKMARK(module->nativeRate);
+		MenuItem::step();
+	}
+};
+
 struct CloudsWidget : ModuleWidget {
 	ParamWidget *blendParam;
 	ParamWidget *spreadParam;
@@ -422,6 +644,20 @@ struct CloudsWidget : ModuleWidget {
 		menu->addChild(construct<CloudsQualityItem>(&MenuItem::text, "2s 32kHz 16-bit mono", &CloudsQualityItem::module, module, &CloudsQualityItem::quality, 1));
 		menu->addChild(construct<CloudsQualityItem>(&MenuItem::text, "4s 16kHz 8-bit µ-law stereo", &CloudsQualityItem::module, module, &CloudsQualityItem::quality, 2));
 		menu->addChild(construct<CloudsQualityItem>(&MenuItem::text, "8s 16kHz 8-bit µ-law mono", &CloudsQualityItem::module, module, &CloudsQualityItem::quality, 3));
+		menu->addChild(construct<CloudsNativeRateItem>(&MenuItem::text, "Process at the host rate (experimental, changes the sound)", &CloudsNativeRateItem::module, module));
+
+		menu->addChild(construct<MenuLabel>());
+		menu->addChild(construct<MenuLabel>(&MenuLabel::text, "Recording length"));
+		menu->addChild(construct<CloudsDurationItem>(&MenuItem::text, "As set by quality", &CloudsDurationItem::module, module, &CloudsDurationItem::duration, 0.f));
+		for (float duration : {15.f, 30.f, 60.f}) {
+			menu->addChild(construct<CloudsDurationItem>(&MenuItem::text, string::f("%gs", duration), &CloudsDurationItem::module, module, &CloudsDurationItem::duration, duration));
+		}
+
+		appendResamplerQualityMenu(menu, &module->resamplerQuality, [=](ResamplerQuality quality) {
+			return module->getLatency(quality);
+		});
+
+		appendDspTimerMenu(menu, &module->timer, (float) CloudsEngine::BLOCK_SIZE / module->engine.sampleRate);
 	}
 };
 
@@ -1,9 +1,9 @@
 #include <string.h>
 #include "AudibleInstruments.hpp"
 #include "dsp/common.hpp"
-#include "dsp/resampler.hpp"
 #include "dsp/ringbuffer.hpp"
-#include "elements/dsp/part.h"
+#include "core/ElementsEngine.hpp"
+#include "core/IdleDetector.hpp"
 
 
 struct Elements : Module {
@@ -74,37 +74,48 @@ struct Elements : Module {
 		NUM_LIGHTS
 	};
 
-	dsp::SampleRateConverter<2> inputSrc;
-	dsp::SampleRateConverter<2> outputSrc;
+	Resampler<2> inputSrc;
+	Resampler<2> outputSrc;
+	ResamplerQuality resamplerQuality = RESAMPLER_HIGH_QUALITY;
 	dsp::DoubleRingBuffer<dsp::Frame<2>, 256> inputBuffer;
 	dsp::DoubleRingBuffer<dsp::Frame<2>, 256> outputBuffer;
 
-	uint16_t reverb_buffer[32768] = {};
-	elements::Part *part;
+	ElementsEngine engine;
+	DspTimer timer;
+	IdleDetector idle;
 
 	Elements();
-	~Elements();
 	void process(const ProcessArgs &args) override;
 
+	void onSampleRateChange() override {
+		int sampleRate = APP->engine->getSampleRate();
+		inputSrc.setRates(sampleRate, ElementsEngine::SAMPLE_RATE);
+		outputSrc.setRates(ElementsEngine::SAMPLE_RATE, sampleRate);
+	}
+
 	json_t *dataToJson() override {
 		json_t *rootJ = json_object();
-		json_object_set_new(rootJ, "model", json_integer(getModel()));
+		json_object_set_new(rootJ, "model", json_integer(engine.getModel()));
+		json_object_set_new(rootJ, "resamplerQuality", json_integer(resamplerQuality));
 		return rootJ;
 	}
 
 	void dataFromJson(json_t *rootJ) override {
 		json_t *modelJ = json_object_get(rootJ, "model");
 		if (modelJ) {
-			setModel(json_integer_value(modelJ));
+			engine.setModel(json_integer_value(modelJ));
 		}
-	}
 
-	int getModel() {
-		return (int)part->resonator_model();
+		json_t *resamplerQualityJ = json_object_get(rootJ, "resamplerQuality");
+		if (resamplerQualityJ) {
+			resamplerQuality = (ResamplerQuality) clamp((int) json_integer_value(resamplerQualityJ), 0, NUM_RESAMPLER_QUALITIES - 1);
+		}
 	}
 
-	void setModel(int model) {
-		part->set_resonator_model((elements::ResonatorModel)model);
+	/** Returns the latency of the input to output path in seconds with the given resampler quality */
+	float getLatency(ResamplerQuality quality) {
+		int sampleRate = APP->engine->getSampleRate();
+		return ResamplerFilter::getLatency(quality, sampleRate, ElementsEngine::SAMPLE_RATE) + ResamplerFilter::getLatency(quality, ElementsEngine::SAMPLE_RATE, sampleRate);
 	}
 };
 
@@ -134,17 +145,11 @@ Elements::Elements() {
 	params[Elements::BLOW_TIMBRE_MOD_PARAM].config(-1.0, 1.0, 0, "BlowTimbreMod");
 	params[Elements::PLAY_PARAM].config(0.0, 1.0, 0.0, "Play");
 
-	part = new elements::Part();
-	// In the Mutable Instruments code, Part doesn't initialize itself, so zero it here.
-	memset(part, 0, sizeof(*part));
-	part->Init(reverb_buffer);
-	// Just some random numbers
-	uint32_t seed[3] = {1, 2, 3};
-	part->Seed(seed, 3);
-}
+	// Long enough for the reverb tail to fall below the threshold
+	idle.setHold(0.1f, ElementsEngine::BLOCK_SIZE, ElementsEngine::SAMPLE_RATE);
+	idle.fadeFrames = ElementsEngine::SAMPLE_RATE / 1000;
 
-Elements::~Elements() {
-	delete part;
+	onSampleRateChange();
 }
 
 void Elements::process(const ProcessArgs &args) {
@@ -158,28 +163,30 @@ void Elements::process(const ProcessArgs &args) {
 
 	// Render frames
 	if (outputBuffer.empty()) {
-		float blow[16] = {};
-		float strike[16] = {};
-		float main[16];
-		float aux[16];
+		float blow[ElementsEngine::BLOCK_SIZE] = {};
+		float strike[ElementsEngine::BLOCK_SIZE] = {};
+		float main[ElementsEngine::BLOCK_SIZE] = {};
+		float aux[ElementsEngine::BLOCK_SIZE] = {};
+		float inputPeak = 0.f;
 
 		// Convert input buffer
 		{
-			inputSrc.setRates(args.sampleRate, 32000);
-			dsp::Frame<2> inputFrames[16];
+			inputSrc.setQuality(resamplerQuality);
+			dsp::Frame<2> inputFrames[ElementsEngine::BLOCK_SIZE];
 			int inLen = inputBuffer.size();
-			int outLen = 16;
+			int outLen = ElementsEngine::BLOCK_SIZE;
 			inputSrc.process(inputBuffer.startData(), &inLen, inputFrames, &outLen);
 			inputBuffer.startIncr(inLen);
 
 			for (int i = 0; i < outLen; i++) {
 				blow[i] = inputFrames[i].samples[0];
 				strike[i] = inputFrames[i].samples[1];
+				inputPeak = fmaxf(inputPeak, fmaxf(fabsf(blow[i]), fabsf(strike[i])));
 			}
 		}
 
 		// Set patch from parameters
-		elements::Patch* p = part->mutable_patch();
+		elements::Patch* p = engine.patch();
 		p->exciter_envelope_shape = params[CONTOUR_PARAM].getValue();
 		p->exciter_bow_level = params[BOW_PARAM].getValue();
 		p->exciter_blow_level = params[BLOW_PARAM].getValue();
@@ -205,19 +212,26 @@ void Elements::process(const ProcessArgs &args) {
 		performance.gate = params[PLAY_PARAM].getValue() >= 1.0 || inputs[GATE_INPUT].getVoltage() >= 1.0;
 		performance.strength = clamp(1.0 - inputs[STRENGTH_INPUT].getVoltage()/5.0f, 0.0f, 1.0f);
 
-		// Generate audio
-		part->Process(performance, blow, strike, main, aux, 16);
+		// Generate audio, unless the resonator has rung out with the gate off and no external excitation
+		bool rendered = idle.wake(performance.gate || inputPeak >= idle.threshold);
+		if (rendered) {
+			timer.start();
+			engine.process(performance, blow, strike, main, aux);
+			timer.stop();
+		}
 
 		// Convert output buffer
 		{
-			dsp::Frame<2> outputFrames[16];
-			for (int i = 0; i < 16; i++) {
+			dsp::Frame<2> outputFrames[ElementsEngine::BLOCK_SIZE];
+			for (int i = 0; i < ElementsEngine::BLOCK_SIZE; i++) {
 				outputFrames[i].samples[0] = main[i];
 				outputFrames[i].samples[1] = aux[i];
 			}
+			if (rendered)
+				idle.process((float*) outputFrames, ElementsEngine::BLOCK_SIZE, 2, engine.part->resonator_level() < 1e-3f);
 
-			outputSrc.setRates(32000, args.sampleRate);
-			int inLen = 16;
+			outputSrc.setQuality(resamplerQuality);
+			int inLen = ElementsEngine::BLOCK_SIZE;
 			int outLen = outputBuffer.capacity();
 			outputSrc.process(outputFrames, &inLen, outputBuffer.endData(), &outLen);
 			outputBuffer.endIncr(outLen);
@@ -225,8 +239,8 @@ void Elements::process(const ProcessArgs &args) {
 
 		// Set lights
 		lights[GATE_LIGHT].setBrightness(performance.gate ? 0.75 : 0.0);
-		lights[EXCITER_LIGHT].setBrightness(part->exciter_level());
-		lights[RESONATOR_LIGHT].setBrightness(part->resonator_level());
+		lights[EXCITER_LIGHT].setBrightness(rendered ? engine.part->exciter_level() : 0.0);
+		lights[RESONATOR_LIGHT].setBrightness(rendered ? engine.part->resonator_level() : 0.0);
 	}
 
 	// Set output
@@ -242,10 +256,10 @@ struct ElementsModalItem : MenuItem {
 	Elements *elements;
 	int model;
 	void onAction(const ActionEvent &e) override {
-		elements->setModel(model);
+		elements->engine.setModel(model);
 	}
 	void step() override {
-		rightText = CHECKMARK(elements->getModel() == model);
+		rightText = CHECKMARK(elements->engine.getModel() == model);
 		MenuItem::step();
 	}
 };
@@ -338,6 +352,12 @@ struct ElementsWidget : ModuleWidget {
 		menu->addChild(construct<ElementsModalItem>(&MenuItem::text, "Original", &ElementsModalItem::elements, elements, &ElementsModalItem::model, 0));
 		menu->addChild(construct<ElementsModalItem>(&MenuItem::text, "Non-linear string", &ElementsModalItem::elements, elements, &ElementsModalItem::model, 1));
 		menu->addChild(construct<ElementsModalItem>(&MenuItem::text, "Chords", &ElementsModalItem::elements, elements, &ElementsModalItem::model, 2));
+
+		appendResamplerQualityMenu(menu, &elements->resamplerQuality, [=](ResamplerQuality quality) {
+			return elements->getLatency(quality);
+		});
+
+		appendDspTimerMenu(menu, &elements->timer, (float) ElementsEngine::BLOCK_SIZE / ElementsEngine::SAMPLE_RATE);
 	}
 };
 
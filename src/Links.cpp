@@ -1,4 +1,5 @@
 #include "AudibleInstruments.hpp"
+#include "core/LinksEngine.hpp"
 
 
 struct Links : Module {
@@ -30,29 +31,38 @@ struct Links : Module {
 		NUM_LIGHTS
 	};
 
-	Links() : Module(NUM_PARAMS, NUM_INPUTS, NUM_OUTPUTS, NUM_LIGHTS) {}
+	dsp::ClockDivider lightDivider;
+	LightPeak peaks[3];
+
+	Links() : Module(NUM_PARAMS, NUM_INPUTS, NUM_OUTPUTS, NUM_LIGHTS) {
+		lightDivider.setDivision(LIGHT_DIVISION);
+	}
 	void step() override;
 };
 
 
 void Links::step() {
-	float inA = inputs[A1_INPUT].value;
-	float inB = inputs[B1_INPUT].value + inputs[B2_INPUT].value;
-	float inC = inputs[C1_INPUT].value + inputs[C2_INPUT].value + inputs[C3_INPUT].value;
-
-	outputs[A1_OUTPUT].value = inA;
-	outputs[A2_OUTPUT].value = inA;
-	outputs[A3_OUTPUT].value = inA;
-	outputs[B1_OUTPUT].value = inB;
-	outputs[B2_OUTPUT].value = inB;
-	outputs[C1_OUTPUT].value = inC;
-
-	lights[A_POS_LIGHT].setBrightnessSmooth(fmaxf(0.0, inA / 5.0));
-	lights[A_NEG_LIGHT].setBrightnessSmooth(fmaxf(0.0, -inA / 5.0));
-	lights[B_POS_LIGHT].setBrightnessSmooth(fmaxf(0.0, inB / 5.0));
-	lights[B_NEG_LIGHT].setBrightnessSmooth(fmaxf(0.0, -inB / 5.0));
-	lights[C_POS_LIGHT].setBrightnessSmooth(fmaxf(0.0, inC / 5.0));
-	lights[C_NEG_LIGHT].setBrightnessSmooth(fmaxf(0.0, -inC / 5.0));
+	// The engine's ports are in the order of the module's
+	float in[LinksEngine::NUM_INPUTS];
+	for (int i = 0; i < LinksEngine::NUM_INPUTS; i++) {
+		in[i] = inputs[A1_INPUT + i].value;
+	}
+	float out[LinksEngine::NUM_OUTPUTS];
+	LinksEngine::process(in, out);
+	for (int i = 0; i < LinksEngine::NUM_OUTPUTS; i++) {
+		outputs[A1_OUTPUT + i].value = out[i];
+	}
+
+	peaks[0].process(out[A1_OUTPUT] / 5.0);
+	peaks[1].process(out[B1_OUTPUT] / 5.0);
+	peaks[2].process(out[C1_OUTPUT] / 5.0);
+	if (lightDivider.process()) {
+		for (int i = 0; i < 3; i++) {
+			lights[A_POS_LIGHT + 2*i].setBrightnessSmooth(peaks[i].pos, LIGHT_DIVISION);
+			lights[A_NEG_LIGHT + 2*i].setBrightnessSmooth(-peaks[i].neg, LIGHT_DIVISION);
+			peaks[i].reset();
+		}
+	}
 }
 
 
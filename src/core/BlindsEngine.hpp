@@ -0,0 +1,30 @@
+#pragma once
+#include <algorithm>
+
+
+/** Audio path of the Blinds module, independent of Rack.
+Each channel scales its input by a gain, and channels are summed down to the next connected output.
+*/
+struct BlindsEngine {
+	static const int NUM_CHANNELS = 4;
+
+	/** Returns a channel's gain from its knob, its CV attenuverter and its CV in volts, from -2 to 2 */
+	static float getGain(float gain, float mod, float cv) {
+		float g = gain;
+		g += mod * cv / 5.0;
+		return std::min(std::max(g, -2.f), 2.f);
+	}
+
+	/** Writes to `out[i]` the sum of the scaled inputs reaching channel i.
+	That is channel i's output when `connected[i]`, after which the next channel starts a new sum.
+	*/
+	static void process(const float *gains, const float *in, const bool *connected, float *out) {
+		float sum = 0.f;
+		for (int i = 0; i < NUM_CHANNELS; i++) {
+			sum += gains[i] * in[i];
+			out[i] = sum;
+			if (connected[i])
+				sum = 0.f;
+		}
+	}
+};
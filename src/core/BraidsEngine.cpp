@@ -0,0 +1,451 @@
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include "BraidsEngine.hpp"
+#include "braids/quantizer_scales.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+
+const char *BraidsEngine::shapeNames[] = {
+	"CSAW",
+	"/\\-_",
+	"//-_",
+	"FOLD",
+	"uuuu",
+	"SUB-",
+	"SUB/",
+	"SYN-",
+	"SYN/",
+	"//x3",
+	"-_x3",
+	"/\\x3",
+	"SIx3",
+	"RING",
+	"////",
+	"//uu",
+	"TOY*",
+	"ZLPF",
+	"ZPKF",
+	"ZBPF",
+	"ZHPF",
+	"VOSM",
+	"VOWL",
+	"VFOF",
+	"HARM",
+	"FM  ",
+	"FBFM",
+	"WTFM",
+	"PLUK",
+	"BOWD",
+	"BLOW",
+	"FLUT",
+	"BELL",
+	"DRUM",
+	"KICK",
+	"CYMB",
+	"SNAR",
+	"WTBL",
+	"WMAP",
+	"WLIN",
+	"WTx4",
+	"NOIS",
+	"TWNQ",
+	"CLKN",
+	"CLOU",
+	"PRTC",
+	"QPSK",
+	"    ",
+};
+
+
+const char *BraidsEngine::scaleNames[NUM_SCALES] = {
+	"OFF ", "SEMI", "IONI", "DORI", "PHRY", "LYDI", "MIXO", "AEOL", "LOCR", "BLU+", "BLU-", "PEN+", "PEN-", "FOLK", "JAPA", "GAME", "GYPS", "ARAB", "FLAM", "WHOL", "PYTH", "EB/4", "E /4", "EA/4", "BHAI", "GUNA", "MARW", "SHRI", "PURV", "BILA", "YAMA", "KAFI", "BHIM", "DARB", "RAGE", "KHAM", "MIMA", "PARA", "RANG", "GANG", "KAME", "PAKA", "NATB", "KAUN", "BAIR", "BTOD", "CHAN", "KTOD", "JOGE",
+};
+
+static_assert(sizeof(braids::scales) / sizeof(braids::scales[0]) == BraidsEngine::NUM_SCALES, "scaleNames must cover braids::scales");
+
+const char *BraidsEngine::rootNames[12] = {
+	"C", "C#", "D", "D#", "E", "F", "F#", "G", "G#", "A", "A#", "B",
+};
+
+
+/** Returns the quantizer configured for a scale.
+Configure() builds a codebook covering every octave, so each scale is built once and copied to the voices.
+*/
+static const braids::Quantizer &getScaleQuantizer(int scale) {
+	struct ScaleQuantizers {
+		braids::Quantizer quantizers[BraidsEngine::NUM_SCALES];
+		ScaleQuantizers() {
+			for (int i = 0; i < BraidsEngine::NUM_SCALES; i++) {
+				memset(&quantizers[i], 0, sizeof(quantizers[i]));
+				quantizers[i].Init();
+				quantizers[i].Configure(braids::scales[i]);
+			}
+		}
+	};
+	static const ScaleQuantizers scaleQuantizers;
+	return scaleQuantizers.quantizers[scale];
+}
+
+
+const char *BraidsEngine::chordNames[NUM_CHORDS] = {
+	"OFF", "OCT", "5TH", "SUS4", "MAJ", "MIN", "MAJ7", "MIN7", "DOM7",
+};
+
+const int BraidsEngine::chordTones[NUM_CHORDS] = {1, 2, 2, 3, 3, 3, 4, 4, 4};
+
+const int BraidsEngine::chordIntervals[NUM_CHORDS][MAX_CHORD_TONES] = {
+	{0},
+	{0, 12},
+	{0, 7},
+	{0, 5, 7},
+	{0, 4, 7},
+	{0, 3, 7},
+	{0, 4, 7, 11},
+	{0, 3, 7, 10},
+	{0, 4, 7, 10},
+};
+
+
+const int BraidsEngine::renderRates[NUM_RENDER_RATES] = {48000, 96000, 192000};
+
+
+BraidsEngine::BraidsEngine() {
+	for (int i = 0; i < MAX_VOICES; i++) {
+		memset(&osc[i], 0, sizeof(osc[i]));
+		osc[i].Init();
+		memset(&jitter_source[i], 0, sizeof(jitter_source[i]));
+		jitter_source[i].Init();
+		quantizer[i] = getScaleQuantizer(0);
+		quantizerScale[i] = 0;
+		memset(&envelope[i], 0, sizeof(envelope[i]));
+		envelope[i].Init();
+		envelopePhase[i] = 0;
+		envelopeValue[i] = 0;
+		gainLp[i] = 65535;
+		holdSample[i] = 0;
+		holdPhase[i] = 0;
+	}
+	memset(&ws, 0, sizeof(ws));
+	ws.Init(0x0000);
+	memset(&settings, 0, sizeof(settings));
+
+	// List of supported settings
+	settings.resolution = braids::RESOLUTION_16_BIT;
+	settings.sample_rate = braids::SAMPLE_RATE_96K;
+	settings.meta_modulation = 0;
+	settings.vco_drift = 0;
+	settings.signature = 0;
+}
+
+void BraidsEngine::render(int voice, const Controls &controls, float *out, int stride) {
+	// The firmware renders the envelope once per block, so it's rendered as many times as firmware blocks have elapsed, keeping ATTK and DECY in time at any render rate
+	envelope[voice].Update(settings.ad_attack * 8, settings.ad_decay * 8);
+	if (controls.strike >= 0)
+		envelope[voice].Trigger(braids::ENV_SEGMENT_ATTACK);
+	envelopePhase[voice] += SAMPLE_RATE;
+	while (envelopePhase[voice] >= sampleRate) {
+		envelopePhase[voice] -= sampleRate;
+		envelopeValue[voice] = envelope[voice].Render();
+	}
+	int32_t ad = envelopeValue[voice];
+
+	// Set shape
+	int shape = roundf(controls.shape * braids::MACRO_OSC_SHAPE_LAST_ACCESSIBLE_FROM_META);
+	if (settings.meta_modulation) {
+		shape += roundf(controls.fm / 10.0 * braids::MACRO_OSC_SHAPE_LAST_ACCESSIBLE_FROM_META);
+	}
+	shape = std::min(std::max(shape, 0), (int) braids::MACRO_OSC_SHAPE_LAST_ACCESSIBLE_FROM_META);
+	if (voice == 0)
+		settings.shape = shape;
+
+	// Set timbre/modulation, with the envelope amounts in 15ths of the full range
+	float timbre = controls.timbre + ad / 65535.f * settings.ad_timbre / 15.f;
+	float color = controls.color + ad / 65535.f * settings.ad_color / 15.f;
+	int16_t param1 = std::min(std::max(timbre, 0.f), 1.f) * INT16_MAX;
+	int16_t param2 = std::min(std::max(color, 0.f), 1.f) * INT16_MAX;
+
+	// The envelope sweeps the pitch by up to 5 octaves, as in the firmware
+	int32_t adPitch = ad * settings.ad_fm >> 7;
+
+	// The firmware disables hard sync when the trigger is routed to the envelope
+	const Controls *oscControls = &controls;
+	Controls unsynced;
+	if (settings.ad_vca || settings.ad_timbre || settings.ad_color || settings.ad_fm) {
+		unsynced = controls;
+		memset(unsynced.sync, 0, sizeof(unsynced.sync));
+		oscControls = &unsynced;
+	}
+
+	int16_t render_buffer[BLOCK_SIZE];
+	int tones = getTones();
+	if (tones == 1) {
+		renderOscillator(voice, *oscControls, shape, param1, param2, 0, adPitch, render_buffer);
+	}
+	else {
+		// Tones are averaged so the chord never clips
+		const int *intervals = chordIntervals[std::min((int) chord, NUM_CHORDS - 1)];
+		int32_t sum[BLOCK_SIZE] = {};
+		for (int i = 0; i < tones; i++) {
+			int16_t tone[BLOCK_SIZE];
+			renderOscillator(voice * tones + i, *oscControls, shape, param1, param2, intervals[i], adPitch, tone);
+			for (int j = 0; j < BLOCK_SIZE; j++) {
+				sum[j] += tone[j];
+			}
+		}
+		for (int j = 0; j < BLOCK_SIZE; j++) {
+			render_buffer[j] = sum[j] / tones;
+		}
+	}
+
+	sampleAndHold(voice, render_buffer);
+	uint16_t gain = settings.ad_vca ? ad : 65535;
+
+	if (floatPath) {
+		// Post-process in place when the caller renders a single voice contiguously, as the bench does.
+		// The module renders voices into interleaved frames, so it always goes through `block`.
+		float block[BLOCK_SIZE];
+		float *buffer = (stride == 1) ? out : block;
+		convertToFloat(render_buffer, buffer);
+		postProcessFloat(voice, buffer, gain);
+		if (stride != 1) {
+			for (int i = 0; i < BLOCK_SIZE; i++) {
+				out[i * stride] = buffer[i];
+			}
+		}
+		return;
+	}
+
+	postProcess(voice, render_buffer, gain);
+	for (int i = 0; i < BLOCK_SIZE; i++) {
+		out[i * stride] = render_buffer[i] * (1.f / 32768.f);
+	}
+}
+
+void BraidsEngine::renderOscillator(int index, const Controls &controls, int shape, int16_t param1, int16_t param2, int interval, int32_t adPitch, int16_t *buffer) {
+	braids::MacroOscillator &osc = this->osc[index];
+	osc.set_shape((braids::MacroOscillatorShape) shape);
+	osc.set_parameters(param1, param2);
+
+	// Set pitch
+	int scale = std::min((int) settings.quantizer_scale, NUM_SCALES - 1);
+	int32_t pitch;
+	if (scale == 0) {
+		float pitchV = controls.pitch + interval / 12.f + pitchOffset;
+		if (!settings.meta_modulation)
+			pitchV += controls.fm;
+		pitch = (pitchV * 12.0 + 60) * 128;
+	}
+	else {
+		// Quantize before FM, as in the firmware, and before the rate's pitch offset, which isn't musical
+		if (quantizerScale[index] != scale) {
+			quantizer[index] = getScaleQuantizer(scale);
+			quantizerScale[index] = scale;
+		}
+		float pitchV = controls.pitch + interval / 12.f;
+		pitch = (pitchV * 12.0 + 60) * 128;
+		pitch = quantizer[index].Process(pitch, (60 + settings.quantizer_root % 12) << 7);
+		float offsetV = pitchOffset;
+		if (!settings.meta_modulation)
+			offsetV += controls.fm;
+		pitch += (int32_t) roundf(offsetV * 12 * 128);
+	}
+	pitch += adPitch;
+	pitch += jitter_source[index].Render(settings.vco_drift);
+	pitch = std::min(std::max(pitch, (int32_t) 0), (int32_t) 16383);
+	osc.set_pitch(pitch);
+
+	// Split the block at the strike, so the attack starts on its sample without rendering smaller blocks elsewhere
+	int split = (controls.strike >= 0) ? std::min(controls.strike & ~1, (int) BLOCK_SIZE) : BLOCK_SIZE;
+	if (split > 0)
+		osc.Render(controls.sync, buffer, split);
+	if (split < BLOCK_SIZE) {
+		osc.Strike();
+		osc.Render(controls.sync + split, buffer + split, BLOCK_SIZE - split);
+	}
+}
+
+
+#if defined(__SSE2__)
+
+/** Exact stmlib::Mix() of 8 samples with a constant balance */
+static inline __m128i mix8(__m128i a, __m128i b, uint16_t balance) {
+	// Unsigned 16-bit weights are multiplied as signed, then the products are corrected by adding x << 16 where the weight's top bit is set
+	uint16_t wa = 65535 - balance;
+	uint16_t wb = balance;
+	__m128i hiA = _mm_mulhi_epi16(a, _mm_set1_epi16((int16_t) wa));
+	__m128i loA = _mm_mullo_epi16(a, _mm_set1_epi16((int16_t) wa));
+	if (wa & 0x8000)
+		hiA = _mm_add_epi16(hiA, a);
+	__m128i hiB = _mm_mulhi_epi16(b, _mm_set1_epi16((int16_t) wb));
+	__m128i loB = _mm_mullo_epi16(b, _mm_set1_epi16((int16_t) wb));
+	if (wb & 0x8000)
+		hiB = _mm_add_epi16(hiB, b);
+	__m128i sumLo = _mm_add_epi32(_mm_unpacklo_epi16(loA, hiA), _mm_unpacklo_epi16(loB, hiB));
+	__m128i sumHi = _mm_add_epi32(_mm_unpackhi_epi16(loA, hiA), _mm_unpackhi_epi16(loB, hiB));
+	return _mm_packs_epi32(_mm_srai_epi32(sumLo, 16), _mm_srai_epi32(sumHi, 16));
+}
+
+#endif
+
+
+void BraidsEngine::convertToFloat(const int16_t *in, float *out) {
+#if defined(__SSE2__)
+	__m128 scale = _mm_set1_ps(1.f / 32768.f);
+	for (int i = 0; i < BLOCK_SIZE; i += 8) {
+		__m128i x = _mm_loadu_si128((const __m128i*) &in[i]);
+		// Sign-extend to 32 bits by unpacking into the high halves and shifting back
+		__m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16);
+		__m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16);
+		_mm_storeu_ps(&out[i], _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+		_mm_storeu_ps(&out[i + 4], _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+	}
+#else
+	for (int i = 0; i < BLOCK_SIZE; i++) {
+		out[i] = in[i] * (1.f / 32768.f);
+	}
+#endif
+}
+
+
+/** Rates of the RATE setting, which the firmware reaches by decimating its 96 kHz blocks */
+static const int holdRates[braids::SAMPLE_RATE_LAST] = {4000, 8000, 16000, 24000, 32000, 48000, 96000};
+static const uint16_t bitMasks[braids::RESOLUTION_LAST] = {0xc000, 0xe000, 0xf000, 0xfc00, 0xff00, 0xfff0, 0xffff};
+
+void BraidsEngine::sampleAndHold(int voice, int16_t *buffer) {
+	int holdRate = holdRates[std::min((int) settings.sample_rate, braids::SAMPLE_RATE_LAST - 1)];
+	if (holdRate >= sampleRate) {
+		// Take a sample at the start of the next hold
+		holdPhase[voice] = sampleRate;
+		return;
+	}
+	// The phase carries across blocks, so rates that don't divide the render rate are held for the right time on average.
+	// At 96 kHz, the samples taken are the firmware's.
+	int phase = holdPhase[voice];
+	int16_t sample = holdSample[voice];
+	for (int i = 0; i < BLOCK_SIZE; i++) {
+		if (phase >= sampleRate) {
+			phase -= sampleRate;
+			sample = buffer[i];
+		}
+		buffer[i] = sample;
+		phase += holdRate;
+	}
+	holdPhase[voice] = phase;
+	holdSample[voice] = sample;
+}
+
+/** The VCA's smoothing stops up to 15 steps short of its target, so snap to unity, where the VCA is skipped */
+static int32_t settleGain(int32_t lp, uint16_t gain) {
+	return (gain == 65535 && lp > 65535 - 16) ? 65535 : lp;
+}
+
+void BraidsEngine::postProcess(int voice, int16_t *buffer, uint16_t gain) {
+	uint16_t bitMask = bitMasks[std::min((int) settings.resolution, braids::RESOLUTION_LAST - 1)];
+	uint16_t signature = settings.signature * settings.signature * 4095;
+
+	if (bitMask != 0xffff) {
+#if defined(__SSE2__)
+		__m128i mask = _mm_set1_epi16((int16_t) bitMask);
+		for (int i = 0; i < BLOCK_SIZE; i += 8) {
+			__m128i x = _mm_loadu_si128((__m128i*) &buffer[i]);
+			_mm_storeu_si128((__m128i*) &buffer[i], _mm_and_si128(x, mask));
+		}
+#else
+		for (int i = 0; i < BLOCK_SIZE; i++) {
+			buffer[i] &= bitMask;
+		}
+#endif
+	}
+
+	// The firmware's VCA scales by at most 65535/65536, which would lower positive samples by one LSB, so it's skipped once the gain has settled at unity without the AD VCA
+	if (gain != 65535 || gainLp[voice] != 65535) {
+		int32_t lp = gainLp[voice];
+		for (int i = 0; i < BLOCK_SIZE; i++) {
+			buffer[i] = buffer[i] * lp >> 16;
+			lp += (gain - lp) >> 4;
+		}
+		gainLp[voice] = settleGain(lp, gain);
+	}
+
+	// Mix() also scales the dry sample by 65535/65536 at SIGN 0, so only the waveshaper is skipped then, whose weight is 0.
+	// The waveshaper is a table lookup, so only the mix is vectorized.
+	int16_t warped[BLOCK_SIZE] = {};
+	if (signature > 0) {
+		for (int i = 0; i < BLOCK_SIZE; i++) {
+			warped[i] = ws.Transform(buffer[i]);
+		}
+	}
+#if defined(__SSE2__)
+	for (int i = 0; i < BLOCK_SIZE; i += 8) {
+		__m128i x = _mm_loadu_si128((__m128i*) &buffer[i]);
+		__m128i w = _mm_loadu_si128((__m128i*) &warped[i]);
+		_mm_storeu_si128((__m128i*) &buffer[i], mix8(x, w, signature));
+	}
+#else
+	for (int i = 0; i < BLOCK_SIZE; i++) {
+		buffer[i] = stmlib::Mix(buffer[i], warped[i], signature);
+	}
+#endif
+}
+
+void BraidsEngine::postProcessFloat(int voice, float *buffer, uint16_t gain) {
+	uint16_t bitMask = bitMasks[std::min((int) settings.resolution, braids::RESOLUTION_LAST - 1)];
+	uint16_t signature = settings.signature * settings.signature * 4095;
+
+	if (bitMask != 0xffff) {
+		// Masking the low bits of a two's complement sample floors it to a multiple of the step
+		float step = (65536 - bitMask) / 32768.f;
+		float invStep = 1.f / step;
+#if defined(__SSE2__)
+		__m128 stepV = _mm_set1_ps(step);
+		__m128 invStepV = _mm_set1_ps(invStep);
+		__m128 one = _mm_set1_ps(1.f);
+		for (int i = 0; i < BLOCK_SIZE; i += 4) {
+			__m128 x = _mm_mul_ps(_mm_loadu_ps(&buffer[i]), invStepV);
+			// SSE2 has no floor, so truncate and step down where truncation rounded up
+			__m128 t = _mm_cvtepi32_ps(_mm_cvttps_epi32(x));
+			t = _mm_sub_ps(t, _mm_and_ps(_mm_cmpgt_ps(t, x), one));
+			_mm_storeu_ps(&buffer[i], _mm_mul_ps(t, stepV));
+		}
+#else
+		for (int i = 0; i < BLOCK_SIZE; i++) {
+			buffer[i] = floorf(buffer[i] * invStep) * step;
+		}
+#endif
+	}
+
+	if (gain != 65535 || gainLp[voice] != 65535) {
+		int32_t lp = gainLp[voice];
+		for (int i = 0; i < BLOCK_SIZE; i++) {
+			buffer[i] *= lp / 65536.f;
+			lp += (gain - lp) >> 4;
+		}
+		gainLp[voice] = settleGain(lp, gain);
+	}
+
+	if (signature > 0) {
+		float warped[BLOCK_SIZE];
+		for (int i = 0; i < BLOCK_SIZE; i++) {
+			int16_t sample = std::min(std::max(buffer[i] * 32768.f, -32768.f), 32767.f);
+			warped[i] = ws.Transform(sample) * (1.f / 32768.f);
+		}
+		float dry = (65535 - signature) / 65536.f;
+		float wet = signature / 65536.f;
+#if defined(__SSE2__)
+		__m128 dryV = _mm_set1_ps(dry);
+		__m128 wetV = _mm_set1_ps(wet);
+		for (int i = 0; i < BLOCK_SIZE; i += 4) {
+			__m128 x = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&buffer[i]), dryV), _mm_mul_ps(_mm_loadu_ps(&warped[i]), wetV));
+			_mm_storeu_ps(&buffer[i], x);
+		}
+#else
+		for (int i = 0; i < BLOCK_SIZE; i++) {
+			buffer[i] = buffer[i] * dry + warped[i] * wet;
+		}
+#endif
+	}
+}
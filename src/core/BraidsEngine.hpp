@@ -0,0 +1,127 @@
+#pragma once
+#include <math.h>
+#include <algorithm>
+#include "braids/macro_oscillator.h"
+#include "braids/vco_jitter_source.h"
+#include "braids/quantizer.h"
+#include "braids/envelope.h"
+#include "braids/signature_waveshaper.h"
+
+
+/** DSP half of the Braids module, independent of Rack.
+Renders blocks of BLOCK_SIZE frames for up to MAX_VOICES voices sharing the same settings.
+The firmware renders at SAMPLE_RATE, other rates are set with setSampleRate().
+*/
+struct BraidsEngine {
+	static const int BLOCK_SIZE = 24;
+	static const int SAMPLE_RATE = 96000;
+	/** Render rates offered besides the host rate, in Hz */
+	static const int NUM_RENDER_RATES = 3;
+	static const int renderRates[NUM_RENDER_RATES];
+	static const int MAX_VOICES = 16;
+	/** Display names of the shapes, indexed by braids::MacroOscillatorShape */
+	static const char *shapeNames[];
+	/** Scales of the firmware quantizer, the first one disables it */
+	static const int NUM_SCALES = 49;
+	static const char *scaleNames[NUM_SCALES];
+	static const char *rootNames[12];
+	/** Chords of the paraphonic mode, as semitones above the root. The first one disables it. */
+	static const int NUM_CHORDS = 9;
+	static const int MAX_CHORD_TONES = 4;
+	static const char *chordNames[NUM_CHORDS];
+	static const int chordTones[NUM_CHORDS];
+	static const int chordIntervals[NUM_CHORDS][MAX_CHORD_TONES];
+
+	struct Controls {
+		/** Shape knob, from 0 to 1 */
+		float shape = 0.f;
+		/** FM amount in volts, routed to the shape when META is enabled */
+		float fm = 0.f;
+		float timbre = 0.5f;
+		float color = 0.5f;
+		/** Pitch in volts, 0V is C4 */
+		float pitch = 0.f;
+		/** Nonzero samples hard-sync the oscillator */
+		uint8_t sync[BLOCK_SIZE] = {};
+		/** Sample at which the voice is struck in this block, or -1.
+		Rounded down to an even sample, so both parts of the split block keep even lengths like the firmware's blocks.
+		*/
+		int strike = -1;
+	};
+
+	/** Oscillator states are stored contiguously.
+	Each voice uses one oscillator, or one per tone in chord mode.
+	*/
+	braids::MacroOscillator osc[MAX_VOICES];
+	braids::VcoJitterSource jitter_source[MAX_VOICES];
+	/** Each oscillator quantizes with hysteresis, so keeps its own copy of the scale's quantizer */
+	braids::Quantizer quantizer[MAX_VOICES];
+	/** Scale each oscillator's quantizer is configured for */
+	uint8_t quantizerScale[MAX_VOICES];
+	/** AD envelope of each voice, rendered once per firmware block of BLOCK_SIZE samples at SAMPLE_RATE */
+	braids::Envelope envelope[MAX_VOICES];
+	/** Elapsed time since each envelope was last rendered, in Hz, rendering it when it reaches the render rate */
+	int envelopePhase[MAX_VOICES];
+	uint16_t envelopeValue[MAX_VOICES];
+	/** VCA gain of each voice, smoothed per sample as in the firmware */
+	int32_t gainLp[MAX_VOICES];
+	/** Sample held by each voice's RATE stage, and its phase in Hz, taking a sample when it reaches the render rate */
+	int16_t holdSample[MAX_VOICES];
+	int holdPhase[MAX_VOICES];
+	braids::SettingsData settings;
+	/** Only holds a lookup table after Init(), so all voices share it */
+	braids::SignatureWaveshaper ws;
+	/** Runs the post-processing in float instead of the firmware's fixed point.
+	The oscillators still render 16-bit samples, but nothing is quantized after them.
+	*/
+	bool floatPath = false;
+	/** Rate of the rendered samples, in Hz */
+	int sampleRate = SAMPLE_RATE;
+	/** Octaves added to the pitch, since the oscillators' pitch tables assume SAMPLE_RATE */
+	float pitchOffset = 0.f;
+	/** Index into the chord tables.
+	The tones of a voice share the decoded controls and are summed before post-processing, so callers resample one channel per voice.
+	*/
+	uint8_t chord = 0;
+
+	BraidsEngine();
+	/** Keeps the oscillators in tune when rendering at `sampleRate`.
+	Only the pitch and the AD envelope are corrected. Decays, formants and densities the firmware sets in samples follow the rate, see the README.
+	*/
+	void setSampleRate(float sampleRate) {
+		this->sampleRate = (int) roundf(sampleRate);
+		pitchOffset = log2f(SAMPLE_RATE / sampleRate);
+	}
+	int getTones() {
+		return chordTones[std::min((int) chord, NUM_CHORDS - 1)];
+	}
+	/** Returns the number of voices that fit in the oscillators with the current chord */
+	int getMaxVoices() {
+		return MAX_VOICES / getTones();
+	}
+	/** Strikes a voice at the start of its next block */
+	void strike(int voice = 0) {
+		int tones = getTones();
+		for (int i = 0; i < tones; i++) {
+			osc[voice * tones + i].Strike();
+		}
+	}
+	/** Renders one block of BLOCK_SIZE samples of a voice to `out`, normalized to [-1, 1].
+	Samples are written `stride` floats apart, so voices can be rendered into interleaved frames.
+	The shape of voice 0 is stored in `settings.shape` for display.
+	*/
+	void render(int voice, const Controls &controls, float *out, int stride = 1);
+	/** Sets up one oscillator from decoded controls, `interval` semitones above the voice's pitch, and renders it to `buffer`.
+	`adPitch` is the envelope's FM in 128ths of a semitone, added after the quantizer.
+	*/
+	void renderOscillator(int index, const Controls &controls, int shape, int16_t param1, int16_t param2, int interval, int32_t adPitch, int16_t *buffer);
+	/** Holds a voice's samples at the RATE setting, in Hz whatever the render rate */
+	void sampleAndHold(int voice, int16_t *buffer);
+	/** Applies the bit reduction, VCA and signature waveshaping to a voice's rendered block, in the firmware's order.
+	`gain` is the VCA's target, from 0 to 65535.
+	*/
+	void postProcess(int voice, int16_t *buffer, uint16_t gain);
+	static void convertToFloat(const int16_t *in, float *out);
+	/** Float version of postProcess(), for samples normalized to [-1, 1] */
+	void postProcessFloat(int voice, float *buffer, uint16_t gain);
+};
@@ -0,0 +1,147 @@
+#include <string.h>
+#include <algorithm>
+#include "CloudsEngine.hpp"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+
+static const int memLen = 118784;
+static const int ccmLen = 65536 - 128;
+static const size_t pageSize = 4096;
+/** Firmware buffer lengths in seconds with memLen bytes at SAMPLE_RATE, indexed by quality */
+static const float bufferDurations[4] = {1.f, 2.f, 4.f, 8.f};
+
+
+CloudsMemory *CloudsMemory::create(size_t len, int quality, clouds::PlaybackMode playback) {
+	CloudsMemory *memory = new CloudsMemory();
+	memory->len = len;
+	memory->block = new uint8_t[len + pageSize - 1]();
+	memory->data = (uint8_t*) (((uintptr_t) memory->block + pageSize - 1) & ~(uintptr_t) (pageSize - 1));
+	memory->ccm = new uint8_t[ccmLen]();
+	memory->quality = quality;
+	memory->playback = playback;
+
+	// The first Prepare() lays out and clears the buffers, which is the slow part
+	clouds::GranularProcessor *processor = new clouds::GranularProcessor();
+	memset(processor, 0, sizeof(*processor));
+	processor->Init(memory->data, memory->len, memory->ccm, ccmLen);
+	processor->set_playback_mode(playback);
+	processor->set_quality(quality);
+	processor->Prepare();
+	memory->processor = processor;
+	return memory;
+}
+
+void CloudsMemory::destroy(CloudsMemory *memory) {
+	if (!memory)
+		return;
+	delete memory->processor;
+	delete[] memory->ccm;
+	delete[] memory->block;
+	delete memory;
+}
+
+
+CloudsEngine::CloudsEngine() {
+	allocateMemory();
+}
+
+CloudsEngine::~CloudsEngine() {
+	CloudsMemory::destroy(memory);
+}
+
+size_t CloudsEngine::getMemoryLength() {
+	double len = (double) memLen * sampleRate / SAMPLE_RATE;
+	if (duration > 0.f)
+		len *= duration / bufferDurations[quality & 3];
+	// The processor splits the memory between channels and buffers, so keep its length a multiple of a cache line
+	return (size_t) len & ~(size_t) 63;
+}
+
+/** The processor clears its buffers when switching into or out of the spectral mode, as the firmware does */
+static bool isSpectral(clouds::PlaybackMode playback) {
+	return playback == clouds::PLAYBACK_MODE_SPECTRAL;
+}
+
+bool CloudsEngine::fits(size_t len, int quality, clouds::PlaybackMode playback) {
+	return len == getMemoryLength() && quality == this->quality && isSpectral(playback) == isSpectral(this->playback);
+}
+
+CloudsMemory *CloudsEngine::swapMemory(CloudsMemory *memory) {
+	CloudsMemory *old = this->memory;
+	this->memory = memory;
+	return old;
+}
+
+void CloudsEngine::allocateMemory() {
+	CloudsMemory::destroy(swapMemory(CloudsMemory::create(getMemoryLength(), quality, playback)));
+}
+
+float CloudsEngine::getBufferDuration() {
+	// The memory may still be sized for previous settings
+	return bufferDurations[memory->quality & 3] * memory->len / ((float) memLen * sampleRate / SAMPLE_RATE);
+}
+
+void CloudsEngine::process(const Controls &controls, const float *in, float *out) {
+	// GranularProcessor only takes 16-bit frames and converts them to float itself, so the conversions are vectorized over the interleaved block instead
+	clouds::ShortFrame input[BLOCK_SIZE];
+	int16_t *inputSamples = (int16_t*) input;
+#if defined(__SSE2__)
+	__m128 scale = _mm_set1_ps(32767.0f);
+	__m128 lo = _mm_set1_ps(-32768.0f);
+	__m128 hi = _mm_set1_ps(32767.0f);
+	for (int i = 0; i < 2 * BLOCK_SIZE; i += 8) {
+		// Clamped and truncated like the scalar conversion
+		__m128 a = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(&in[i]), scale), lo), hi);
+		__m128 b = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(&in[i + 4]), scale), lo), hi);
+		_mm_storeu_si128((__m128i*) &inputSamples[i], _mm_packs_epi32(_mm_cvttps_epi32(a), _mm_cvttps_epi32(b)));
+	}
+#else
+	for (int i = 0; i < 2 * BLOCK_SIZE; i++) {
+		inputSamples[i] = std::min(std::max(in[i] * 32767.0f, -32768.0f), 32767.0f);
+	}
+#endif
+
+	// Set up processor.
+	// Changes that would clear the buffers wait for memory created for them, see needsMemory().
+	clouds::GranularProcessor *processor = memory->processor;
+	if (isSpectral(playback) == isSpectral(memory->playback))
+		processor->set_playback_mode(playback);
+	processor->Prepare();
+
+	clouds::Parameters *p = processor->mutable_parameters();
+	p->trigger = controls.trigger;
+	p->gate = controls.trigger;
+	p->freeze = controls.freeze;
+	p->position = controls.position;
+	p->size = controls.size;
+	p->pitch = controls.pitch;
+	p->density = controls.density;
+	p->texture = controls.texture;
+	p->dry_wet = controls.dryWet;
+	p->stereo_spread = controls.spread;
+	p->feedback = controls.feedback;
+	p->reverb = controls.reverb;
+
+	clouds::ShortFrame output[BLOCK_SIZE];
+	processor->Process(input, output, BLOCK_SIZE);
+
+	const int16_t *outputSamples = (const int16_t*) output;
+#if defined(__SSE2__)
+	__m128 invScale = _mm_set1_ps(1.f / 32768.f);
+	for (int i = 0; i < 2 * BLOCK_SIZE; i += 8) {
+		__m128i x = _mm_loadu_si128((const __m128i*) &outputSamples[i]);
+		// Sign-extend to 32 bits by unpacking into the high halves and shifting back
+		__m128i xLo = _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16);
+		__m128i xHi = _mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16);
+		_mm_storeu_ps(&out[i], _mm_mul_ps(_mm_cvtepi32_ps(xLo), invScale));
+		_mm_storeu_ps(&out[i + 4], _mm_mul_ps(_mm_cvtepi32_ps(xHi), invScale));
+	}
+#else
+	for (int i = 0; i < 2 * BLOCK_SIZE; i++) {
+		out[i] = outputSamples[i] / 32768.f;
+	}
+#endif
+}
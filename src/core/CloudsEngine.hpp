@@ -0,0 +1,87 @@
+#pragma once
+#include "clouds/dsp/granular_processor.h"
+
+
+/** Page-aligned recording memory for CloudsEngine, with a processor prepared to record into it.
+Allocating and clearing a long buffer takes time, so modules create and destroy it away from the audio thread.
+*/
+struct CloudsMemory {
+	uint8_t *data;
+	size_t len;
+	/** Unaligned allocation holding `data` */
+	uint8_t *block;
+	/** The processor's small buffer, in the firmware's core-coupled memory */
+	uint8_t *ccm;
+	clouds::GranularProcessor *processor;
+	/** Settings the processor's buffers are laid out for */
+	int quality;
+	clouds::PlaybackMode playback;
+
+	/** Returns zeroed memory of `len` bytes, and a processor whose buffers are already laid out for `quality` and `playback` */
+	static CloudsMemory *create(size_t len, int quality, clouds::PlaybackMode playback);
+	static void destroy(CloudsMemory *memory);
+};
+
+
+/** DSP half of the Clouds module, independent of Rack.
+Processes blocks of BLOCK_SIZE stereo frames at SAMPLE_RATE, or at another rate set with setSampleRate().
+*/
+struct CloudsEngine {
+	static const int BLOCK_SIZE = 32;
+	static const int SAMPLE_RATE = 32000;
+
+	struct Controls {
+		bool trigger = false;
+		bool freeze = false;
+		/** Knobs and CVs, from 0 to 1 */
+		float position = 0.5f;
+		float size = 0.5f;
+		float density = 0.5f;
+		float texture = 0.5f;
+		float dryWet = 0.5f;
+		float spread = 0.f;
+		float feedback = 0.f;
+		float reverb = 0.f;
+		/** Pitch in semitones */
+		float pitch = 0.f;
+	};
+
+	/** Owned by the engine, replaced with swapMemory() */
+	CloudsMemory *memory = NULL;
+	/** The firmware's timings assume SAMPLE_RATE.
+	At other rates the recording memory is scaled to keep the buffer durations, but grain sizes and pitch, density, filters and the reverb follow the rate, which changes the sound.
+	*/
+	int sampleRate = SAMPLE_RATE;
+	/** Recording length in seconds, or 0 for the firmware's length at each quality */
+	float duration = 0.f;
+
+	clouds::PlaybackMode playback = clouds::PLAYBACK_MODE_GRANULAR;
+	int quality = 0;
+
+	CloudsEngine();
+	~CloudsEngine();
+	/** Sets the rate the memory is sized for. The memory itself is only replaced by swapMemory() or allocateMemory(). */
+	void setSampleRate(int sampleRate) {
+		this->sampleRate = sampleRate;
+	}
+	/** Returns the memory length in bytes needed for the rate, quality and duration settings */
+	size_t getMemoryLength();
+	/** Returns whether memory created with these settings runs the current settings without clearing its buffers */
+	bool fits(size_t len, int quality, clouds::PlaybackMode playback);
+	/** Returns whether the memory must be replaced for the current settings.
+	Until then, process() keeps the quality and playback mode the memory was created for, since changing them would clear the buffers on the audio thread.
+	*/
+	bool needsMemory() {
+		return !fits(memory->len, memory->quality, memory->playback);
+	}
+	/** Switches to new memory and its processor, which starts with an empty recording.
+	Only swaps pointers, so it can run on the audio thread. Returns the previous memory for the caller to destroy.
+	*/
+	CloudsMemory *swapMemory(CloudsMemory *memory);
+	/** Replaces the memory with a new allocation for the current settings, for callers without an audio thread */
+	void allocateMemory();
+	/** Returns the length of the recording buffer in seconds at the current quality */
+	float getBufferDuration();
+	/** Processes one block of BLOCK_SIZE interleaved stereo frames, normalized to [-1, 1] */
+	void process(const Controls &controls, const float *in, float *out);
+};
@@ -0,0 +1,77 @@
+#include <chrono>
+#include <algorithm>
+#include "DspTimer.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define DSP_TIMER_TSC 1
+#endif
+
+
+static uint64_t nanoseconds() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+uint64_t dspTimerTicks() {
+#ifdef DSP_TIMER_TSC
+	return __rdtsc();
+#else
+	return nanoseconds();
+#endif
+}
+
+
+static const uint64_t originTicks = dspTimerTicks();
+static const uint64_t originNanoseconds = nanoseconds();
+
+double dspTimerTicksPerSecond() {
+#ifdef DSP_TIMER_TSC
+	// The TSC runs at a constant rate on every CPU Rack supports, so the rate converges as the plugin stays loaded
+	uint64_t elapsed = nanoseconds() - originNanoseconds;
+	if (elapsed < 1000000)
+		return 1e9;
+	return (double) (dspTimerTicks() - originTicks) / elapsed * 1e9;
+#else
+	return 1e9;
+#endif
+}
+
+
+int DspTimer::getBucket(uint64_t ticks) {
+	if (ticks < (1 << SUBBUCKET_BITS))
+		return ticks;
+	int octave = 63 - __builtin_clzll(ticks);
+	int sub = (ticks >> (octave - SUBBUCKET_BITS)) & ((1 << SUBBUCKET_BITS) - 1);
+	return ((octave - SUBBUCKET_BITS + 1) << SUBBUCKET_BITS) + sub;
+}
+
+uint64_t DspTimer::getBucketLimit(int bucket) {
+	if (bucket < (1 << SUBBUCKET_BITS))
+		return bucket + 1;
+	int octave = (bucket >> SUBBUCKET_BITS) + SUBBUCKET_BITS - 1;
+	int sub = bucket & ((1 << SUBBUCKET_BITS) - 1);
+	return ((uint64_t) ((1 << SUBBUCKET_BITS) + sub + 1)) << (octave - SUBBUCKET_BITS);
+}
+
+DspTimer::Stats DspTimer::getStats() const {
+	Stats stats = {};
+	stats.count = count.load(std::memory_order_relaxed);
+	if (stats.count == 0)
+		return stats;
+
+	double secondsPerTick = 1.0 / dspTimerTicksPerSecond();
+	stats.mean = total.load(std::memory_order_relaxed) * secondsPerTick / stats.count;
+	stats.max = max.load(std::memory_order_relaxed) * secondsPerTick;
+
+	// Walk down from the slowest bucket until 1% of the calls are above it
+	uint64_t above = 0;
+	for (int i = NUM_BUCKETS - 1; i >= 0; i--) {
+		above += buckets[i].load(std::memory_order_relaxed);
+		if (above * 100 >= stats.count) {
+			// Buckets only bound the time, so don't report more than the slowest call
+			stats.p99 = std::min(getBucketLimit(i) * secondsPerTick, (double) stats.max);
+			break;
+		}
+	}
+	return stats;
+}
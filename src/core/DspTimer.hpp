@@ -0,0 +1,69 @@
+#pragma once
+#include <stdint.h>
+#include <atomic>
+
+
+/** Reads a cheap monotonic tick counter, the TSC on x86 */
+uint64_t dspTimerTicks();
+/** Returns the number of ticks per second, measured against the system clock since the plugin was loaded */
+double dspTimerTicksPerSecond();
+
+
+/** Histogram of render times for one module instance.
+The audio thread is the only writer, any thread may read the statistics without locking.
+*/
+struct DspTimer {
+	/** Each octave of ticks is split into 1 << SUBBUCKET_BITS buckets */
+	static const int SUBBUCKET_BITS = 2;
+	static const int NUM_BUCKETS = 64 << SUBBUCKET_BITS;
+
+	std::atomic<uint32_t> buckets[NUM_BUCKETS];
+	std::atomic<uint64_t> count;
+	std::atomic<uint64_t> total;
+	std::atomic<uint64_t> max;
+	uint64_t startTicks = 0;
+
+	struct Stats {
+		uint64_t count;
+		/** Seconds per call */
+		float mean;
+		float p99;
+		float max;
+	};
+
+	DspTimer() {
+		reset();
+	}
+
+	void reset() {
+		for (int i = 0; i < NUM_BUCKETS; i++) {
+			buckets[i].store(0, std::memory_order_relaxed);
+		}
+		count.store(0, std::memory_order_relaxed);
+		total.store(0, std::memory_order_relaxed);
+		max.store(0, std::memory_order_relaxed);
+	}
+
+	void start() {
+		startTicks = dspTimerTicks();
+	}
+
+	void stop() {
+		record(dspTimerTicks() - startTicks);
+	}
+
+	void record(uint64_t ticks) {
+		// Only the audio thread writes, so plain load and store pairs are enough
+		std::atomic<uint32_t> &bucket = buckets[getBucket(ticks)];
+		bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		total.store(total.load(std::memory_order_relaxed) + ticks, std::memory_order_relaxed);
+		if (ticks > max.load(std::memory_order_relaxed))
+			max.store(ticks, std::memory_order_relaxed);
+	}
+
+	static int getBucket(uint64_t ticks);
+	/** Returns the upper bound of a bucket in ticks */
+	static uint64_t getBucketLimit(int bucket);
+	Stats getStats() const;
+};
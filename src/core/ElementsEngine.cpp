@@ -0,0 +1,21 @@
+#include <string.h>
+#include "ElementsEngine.hpp"
+
+
+ElementsEngine::ElementsEngine() {
+	part = new elements::Part();
+	// In the Mutable Instruments code, Part doesn't initialize itself, so zero it here.
+	memset(part, 0, sizeof(*part));
+	part->Init(reverb_buffer);
+	// Just some random numbers
+	uint32_t seed[3] = {1, 2, 3};
+	part->Seed(seed, 3);
+}
+
+ElementsEngine::~ElementsEngine() {
+	delete part;
+}
+
+void ElementsEngine::process(const elements::PerformanceState &performance, const float *blow, const float *strike, float *main, float *aux) {
+	part->Process(performance, blow, strike, main, aux, BLOCK_SIZE);
+}
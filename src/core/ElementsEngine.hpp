@@ -0,0 +1,31 @@
+#pragma once
+#include "elements/dsp/part.h"
+
+
+/** DSP half of the Elements module, independent of Rack.
+Processes blocks of BLOCK_SIZE frames at SAMPLE_RATE.
+*/
+struct ElementsEngine {
+	static const int BLOCK_SIZE = 16;
+	static const int SAMPLE_RATE = 32000;
+
+	uint16_t reverb_buffer[32768] = {};
+	elements::Part *part;
+
+	ElementsEngine();
+	~ElementsEngine();
+	/** Renders one block of BLOCK_SIZE frames from the external exciter inputs `blow` and `strike` */
+	void process(const elements::PerformanceState &performance, const float *blow, const float *strike, float *main, float *aux);
+
+	elements::Patch *patch() {
+		return part->mutable_patch();
+	}
+
+	int getModel() {
+		return (int) part->resonator_model();
+	}
+
+	void setModel(int model) {
+		part->set_resonator_model((elements::ResonatorModel) model);
+	}
+};
@@ -0,0 +1,74 @@
+#pragma once
+#include <math.h>
+
+
+/** Puts a block-based engine to sleep once its output has been silent for a while with nothing exciting it.
+Call wake() before each block and render only if it returns true, then pass the rendered block to process().
+While asleep, the caller outputs silence.
+*/
+struct IdleDetector {
+	/** Peak level below which a block counts as silent, about -80 dBFS */
+	float threshold = 1e-4f;
+	/** Consecutive silent blocks before sleeping */
+	int holdBlocks = 1;
+	/** Length of the fade-in after waking, in frames */
+	int fadeFrames = 32;
+
+	int silentBlocks = 0;
+	bool sleeping = false;
+	float fade = 1.f;
+
+	void setHold(float seconds, int blockSize, int sampleRate) {
+		holdBlocks = (int) ceilf(seconds * sampleRate / blockSize);
+		if (holdBlocks < 1)
+			holdBlocks = 1;
+	}
+
+	void reset() {
+		silentBlocks = 0;
+		sleeping = false;
+		fade = 1.f;
+	}
+
+	/** Returns whether the engine should render this block.
+	`excited` is true when an input or control change could make the engine produce sound.
+	*/
+	bool wake(bool excited) {
+		if (excited) {
+			silentBlocks = 0;
+			if (sleeping) {
+				sleeping = false;
+				fade = 0.f;
+			}
+		}
+		return !sleeping;
+	}
+
+	/** Fades in a rendered block of interleaved frames after waking, and counts silent blocks.
+	`quiet` is false when the engine reports internal activity that hasn't reached the output yet.
+	*/
+	void process(float *out, int frames, int channels, bool quiet = true) {
+		float peak = 0.f;
+		for (int i = 0; i < frames * channels; i++) {
+			peak = fmaxf(peak, fabsf(out[i]));
+		}
+
+		if (fade < 1.f) {
+			float step = 1.f / fadeFrames;
+			for (int i = 0; i < frames; i++) {
+				fade = fminf(fade + step, 1.f);
+				for (int c = 0; c < channels; c++) {
+					out[i * channels + c] *= fade;
+				}
+			}
+		}
+
+		if (quiet && peak < threshold) {
+			if (++silentBlocks >= holdBlocks)
+				sleeping = true;
+		}
+		else {
+			silentBlocks = 0;
+		}
+	}
+};
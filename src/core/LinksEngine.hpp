@@ -0,0 +1,24 @@
+#pragma once
+
+
+/** Audio path of the Links module, independent of Rack.
+Input A is copied to three outputs, the two B inputs are summed to two outputs, and the three C inputs to one.
+*/
+struct LinksEngine {
+	/** Inputs A1, B1, B2, C1, C2 and C3 */
+	static const int NUM_INPUTS = 6;
+	/** Outputs A1, A2, A3, B1, B2 and C1 */
+	static const int NUM_OUTPUTS = 6;
+
+	static void process(const float *in, float *out) {
+		float inA = in[0];
+		float inB = in[1] + in[2];
+		float inC = in[3] + in[4] + in[5];
+		out[0] = inA;
+		out[1] = inA;
+		out[2] = inA;
+		out[3] = inB;
+		out[4] = inB;
+		out[5] = inC;
+	}
+};
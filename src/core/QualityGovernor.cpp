@@ -0,0 +1,55 @@
+#include <atomic>
+#include "QualityGovernor.hpp"
+#include "DspTimer.hpp"
+
+
+static std::atomic<int64_t> totalLoad(0);
+static std::atomic<uint64_t> lastChangeTicks(0);
+
+
+QualityGovernor::~QualityGovernor() {
+	reset();
+}
+
+void QualityGovernor::reset() {
+	totalLoad -= published;
+	published = 0;
+	load = 0.f;
+	level = LEVEL_FULL;
+}
+
+QualityGovernor::Level QualityGovernor::process(uint64_t ticks, float seconds, float budget) {
+	if (seconds <= 0.f)
+		return level;
+
+	// The tick rate is refined while the plugin runs, but reading it costs a clock call, so refresh it rarely
+	if (blocks++ % 1024 == 0)
+		ticksPerSecond = dspTimerTicksPerSecond();
+
+	float blockLoad = ticks / (ticksPerSecond * seconds);
+	load += (blockLoad - load) * 0.01f;
+	int64_t share = (int64_t) (load * 1e6f);
+	totalLoad += share - published;
+	published = share;
+
+	uint64_t now = dspTimerTicks();
+	uint64_t last = lastChangeTicks.load(std::memory_order_relaxed);
+	if (now - last < (uint64_t) (settleTime * ticksPerSecond))
+		return level;
+
+	float total = totalLoad.load(std::memory_order_relaxed) * 1e-6f / budget;
+	Level next = level;
+	if (total > highLoad && level < LEVEL_LOW)
+		next = (Level) (level + 1);
+	else if (total < lowLoad && level > LEVEL_FULL)
+		next = (Level) (level - 1);
+
+	// Only one instance wins each settle period, so the patch degrades one step at a time
+	if (next != level && lastChangeTicks.compare_exchange_strong(last, now))
+		level = next;
+	return level;
+}
+
+float QualityGovernor::getTotalLoad() {
+	return totalLoad.load(std::memory_order_relaxed) * 1e-6f;
+}
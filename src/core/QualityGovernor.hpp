@@ -0,0 +1,41 @@
+#pragma once
+#include <stdint.h>
+
+
+/** Chooses a quality level for one module instance from the load of every instance sharing the governor.
+Instances step down when the total load is high and back up when it is low, one instance at a time.
+The total only covers instances using a governor, not the rest of the patch, since Rack doesn't report the engine's overall load to modules.
+*/
+struct QualityGovernor {
+	enum Level {
+		LEVEL_FULL,
+		LEVEL_MEDIUM,
+		LEVEL_LOW,
+		NUM_LEVELS
+	};
+
+	/** Total load, as a fraction of the budget, above which an instance steps down */
+	float highLoad = 0.7f;
+	/** Total load below which an instance steps back up */
+	float lowLoad = 0.35f;
+	/** Seconds to wait after any instance changes level, so the load settles before the next change */
+	float settleTime = 0.5f;
+
+	Level level = LEVEL_FULL;
+	/** Smoothed load of this instance, as a fraction of realtime */
+	float load = 0.f;
+	/** This instance's share of the total, in millionths of realtime */
+	int64_t published = 0;
+	double ticksPerSecond = 0.0;
+	int blocks = 0;
+
+	~QualityGovernor();
+	/** Records the cost of rendering `seconds` of audio in dspTimerTicks() ticks.
+	`budget` is the realtime capacity available, e.g. the number of engine threads.
+	Returns the level this instance should run at.
+	*/
+	Level process(uint64_t ticks, float seconds, float budget);
+	void reset();
+	/** Returns the summed load of all governed instances, as a fraction of realtime */
+	static float getTotalLoad();
+};
@@ -0,0 +1,182 @@
+#include <math.h>
+#include <map>
+#include <mutex>
+#include <tuple>
+#include "Resampler.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define RESAMPLER_X86 1
+#endif
+
+
+/** Zeroth order modified Bessel function of the first kind, for the Kaiser window */
+static double besselI0(double x) {
+	double sum = 1.0;
+	double term = 1.0;
+	for (int k = 1; k < 32; k++) {
+		term *= (x / (2 * k)) * (x / (2 * k));
+		sum += term;
+		if (term < sum * 1e-12)
+			break;
+	}
+	return sum;
+}
+
+static int gcd(int a, int b) {
+	while (b != 0) {
+		int t = a % b;
+		a = b;
+		b = t;
+	}
+	return a;
+}
+
+
+struct QualitySettings {
+	int taps;
+	/** Passband edge relative to the Nyquist frequency of the slower rate */
+	double cutoff;
+	double kaiserBeta;
+};
+
+static const QualitySettings qualitySettings[NUM_RESAMPLER_QUALITIES] = {
+	{16, 0.85, 6.0},
+	{32, 0.90, 8.0},
+	{64, 0.93, 8.6},
+};
+
+
+int ResamplerFilter::getTaps(ResamplerQuality quality) {
+	return qualitySettings[quality].taps;
+}
+
+float ResamplerFilter::getLatency(ResamplerQuality quality, int inRate, int outRate) {
+	if (inRate <= 0 || inRate == outRate)
+		return 0.f;
+	// The windowed sinc is centered in the window of input frames
+	return 0.5f * getTaps(quality) / inRate;
+}
+
+
+/** Allocates `size` floats aligned to 32 bytes, since rows are loaded with aligned SIMD loads */
+static float *allocAligned(int size) {
+	float *buffer = new float[size + 8]();
+	return (float*) (((uintptr_t) buffer + 31) & ~(uintptr_t) 31);
+}
+
+static ResamplerFilter *createFilter(ResamplerQuality quality, int inRate, int outRate) {
+	const QualitySettings &settings = qualitySettings[quality];
+	ResamplerFilter *filter = new ResamplerFilter();
+	int g = gcd(inRate, outRate);
+	filter->up = outRate / g;
+	filter->down = inRate / g;
+	filter->taps = settings.taps;
+	filter->phases = std::min(filter->up, (int) ResamplerFilter::MAX_PHASES);
+	filter->mode = (filter->up == filter->down) ? RESAMPLER_COPY : RESAMPLER_POLYPHASE;
+
+	int taps = filter->taps;
+	filter->coefficients = allocAligned(filter->phases * taps);
+	if (filter->mode == RESAMPLER_COPY)
+		return filter;
+
+	// Cutoff in cycles per input frame, lowered below the output Nyquist frequency when decimating
+	double fc = 0.5 * settings.cutoff * std::min(1.0, (double) outRate / inRate);
+	double i0Beta = besselI0(settings.kaiserBeta);
+	for (int p = 0; p < filter->phases; p++) {
+		double frac = (double) p / filter->phases;
+		float *row = &filter->coefficients[p * taps];
+		double sum = 0.0;
+		for (int k = 0; k < taps; k++) {
+			// Distance in input frames between the output position and history frame k, oldest first
+			double x = taps / 2 - 1 - k + frac;
+			double sinc = (x == 0.0) ? 1.0 : sin(2 * M_PI * fc * x) / (2 * M_PI * fc * x);
+			double w = x / (taps / 2);
+			double window = (fabs(w) >= 1.0) ? 0.0 : besselI0(settings.kaiserBeta * sqrt(1.0 - w * w)) / i0Beta;
+			row[k] = sinc * window;
+			sum += row[k];
+		}
+		// Normalize each phase to unity DC gain, so no phase modulates the level
+		for (int k = 0; k < taps; k++) {
+			row[k] /= sum;
+		}
+	}
+	return filter;
+}
+
+
+const ResamplerFilter *ResamplerFilter::get(ResamplerQuality quality, int inRate, int outRate) {
+	static std::mutex mutex;
+	static std::map<std::tuple<int, int, int>, ResamplerFilter*> filters;
+
+	std::lock_guard<std::mutex> lock(mutex);
+	std::tuple<int, int, int> key(quality, inRate, outRate);
+	auto it = filters.find(key);
+	if (it != filters.end())
+		return it->second;
+	// Filters are kept until the plugin is unloaded, there are only a few rate pairs in practice
+	ResamplerFilter *filter = createFilter(quality, inRate, outRate);
+	filters[key] = filter;
+	return filter;
+}
+
+
+#ifdef RESAMPLER_X86
+
+static float dotSse(const float *x, const float *coefficients, int taps) {
+	// Two accumulators hide the latency of the adds
+	__m128 sum0 = _mm_setzero_ps();
+	__m128 sum1 = _mm_setzero_ps();
+	for (int k = 0; k < taps; k += 8) {
+		sum0 = _mm_add_ps(sum0, _mm_mul_ps(_mm_loadu_ps(&x[k]), _mm_load_ps(&coefficients[k])));
+		sum1 = _mm_add_ps(sum1, _mm_mul_ps(_mm_loadu_ps(&x[k + 4]), _mm_load_ps(&coefficients[k + 4])));
+	}
+	__m128 sum = _mm_add_ps(sum0, sum1);
+	sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+	sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+	return _mm_cvtss_f32(sum);
+}
+
+__attribute__((target("avx")))
+static float dotAvx(const float *x, const float *coefficients, int taps) {
+	__m256 sum0 = _mm256_setzero_ps();
+	__m256 sum1 = _mm256_setzero_ps();
+	int k = 0;
+	for (; k + 16 <= taps; k += 16) {
+		sum0 = _mm256_add_ps(sum0, _mm256_mul_ps(_mm256_loadu_ps(&x[k]), _mm256_load_ps(&coefficients[k])));
+		sum1 = _mm256_add_ps(sum1, _mm256_mul_ps(_mm256_loadu_ps(&x[k + 8]), _mm256_load_ps(&coefficients[k + 8])));
+	}
+	if (k < taps)
+		sum0 = _mm256_add_ps(sum0, _mm256_mul_ps(_mm256_loadu_ps(&x[k]), _mm256_load_ps(&coefficients[k])));
+	__m256 sum256 = _mm256_add_ps(sum0, sum1);
+	__m128 sum = _mm_add_ps(_mm256_castps256_ps128(sum256), _mm256_extractf128_ps(sum256, 1));
+	sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+	sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+	return _mm_cvtss_f32(sum);
+}
+
+#else
+
+static float dotScalar(const float *x, const float *coefficients, int taps) {
+	float sum = 0.f;
+	for (int k = 0; k < taps; k++) {
+		sum += x[k] * coefficients[k];
+	}
+	return sum;
+}
+
+#endif
+
+
+static float (*selectDot())(const float*, const float*, int) {
+#ifdef RESAMPLER_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx"))
+		return dotAvx;
+	return dotSse;
+#else
+	return dotScalar;
+#endif
+}
+
+float (*resamplerDot)(const float *x, const float *coefficients, int taps) = selectDot();
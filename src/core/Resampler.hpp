@@ -0,0 +1,226 @@
+#pragma once
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+
+
+/** Filter length presets, trading latency against stopband rejection */
+enum ResamplerQuality {
+	/** 16 taps */
+	RESAMPLER_LOW_LATENCY,
+	/** 32 taps */
+	RESAMPLER_BALANCED,
+	/** 64 taps, comparable to the speex converter at its default quality */
+	RESAMPLER_HIGH_QUALITY,
+	NUM_RESAMPLER_QUALITIES
+};
+
+
+/** Conversion strategy chosen from the reduced rate ratio */
+enum ResamplerMode {
+	/** Equal rates, frames are copied */
+	RESAMPLER_COPY,
+	/** Any other L:M ratio, including 2:1 and 1:2.
+	A half-band filter can't take these, since its response is always -6 dB at the slower Nyquist frequency and aliases far more just above it than the polyphase design.
+	*/
+	RESAMPLER_POLYPHASE,
+};
+
+
+/** Polyphase filter bank for one quality and rate pair.
+Banks are computed on first use and shared by every resampler in the plugin.
+*/
+struct ResamplerFilter {
+	static const int MAX_TAPS = 64;
+	/** Rate pairs needing more phases than this round the phase to the nearest of MAX_PHASES */
+	static const int MAX_PHASES = 1024;
+
+	/** Interpolation factor L and decimation factor M of the reduced rate ratio */
+	int up;
+	int down;
+	ResamplerMode mode;
+	int taps;
+	int phases;
+	/** `phases` rows of `taps` coefficients, each row in input time order */
+	float *coefficients;
+
+	/** Returns the shared bank for the given settings. Not realtime-safe, since it locks and designs the bank the first time a rate pair is requested. */
+	static const ResamplerFilter *get(ResamplerQuality quality, int inRate, int outRate);
+	static int getTaps(ResamplerQuality quality);
+	/** Returns the group delay of a resampler with these settings, in seconds */
+	static float getLatency(ResamplerQuality quality, int inRate, int outRate);
+};
+
+
+/** The banks of every quality for one rate pair.
+Resamplers keep one, so they can change quality or switch to banks prepared in advance on the audio thread.
+*/
+struct ResamplerBanks {
+	int inRate = 0;
+	int outRate = 0;
+	const ResamplerFilter *filters[NUM_RESAMPLER_QUALITIES] = {};
+
+	/** Not realtime-safe, call from onSampleRateChange() or the UI thread */
+	void setRates(int inRate, int outRate) {
+		if (inRate == this->inRate && outRate == this->outRate)
+			return;
+		this->inRate = inRate;
+		this->outRate = outRate;
+		for (int i = 0; i < NUM_RESAMPLER_QUALITIES; i++) {
+			filters[i] = (inRate > 0 && outRate > 0) ? ResamplerFilter::get((ResamplerQuality) i, inRate, outRate) : NULL;
+		}
+	}
+};
+
+
+/** Dot product of `taps` samples with an aligned coefficient row, using the widest SIMD available on this CPU.
+`taps` must be a multiple of 8.
+*/
+extern float (*resamplerDot)(const float *x, const float *coefficients, int taps);
+
+
+/** Sample rate converter for up to CHANNELS interleaved channels.
+Drop-in replacement for dsp::SampleRateConverter.
+setRates() designs the filters and isn't realtime-safe, the other setters only switch between designed banks.
+*/
+template <int CHANNELS>
+struct Resampler {
+	int channels = CHANNELS;
+	int inRate = 0;
+	int outRate = 0;
+	ResamplerQuality quality = RESAMPLER_HIGH_QUALITY;
+	ResamplerBanks banks;
+	const ResamplerFilter *filter = NULL;
+
+	/** Input position between the two newest frames, in units of 1/filter->up */
+	int phase = 0;
+	/** Each channel's history is written twice, so the newest `taps` frames are always contiguous at `history[c] + head` */
+	float history[CHANNELS][2 * ResamplerFilter::MAX_TAPS];
+	int head = 0;
+
+	Resampler() {
+		reset();
+	}
+
+	void reset() {
+		memset(history, 0, sizeof(history));
+		head = 0;
+		// Start by consuming a frame, so the first output is aligned with the first input
+		phase = filter ? filter->up : 0;
+	}
+
+	void setChannels(int channels) {
+		if (channels == this->channels)
+			return;
+		this->channels = channels;
+		reset();
+	}
+
+	void setQuality(ResamplerQuality quality) {
+		if (quality == this->quality)
+			return;
+		this->quality = quality;
+		refreshFilter();
+	}
+
+	void setRates(int inRate, int outRate) {
+		if (inRate == this->inRate && outRate == this->outRate)
+			return;
+		ResamplerBanks banks;
+		banks.setRates(inRate, outRate);
+		setBanks(banks);
+	}
+
+	/** Switches to banks prepared with ResamplerBanks::setRates() */
+	void setBanks(const ResamplerBanks &banks) {
+		if (banks.inRate == inRate && banks.outRate == outRate)
+			return;
+		this->banks = banks;
+		inRate = banks.inRate;
+		outRate = banks.outRate;
+		refreshFilter();
+	}
+
+	void refreshFilter() {
+		if (banks.filters[quality])
+			filter = banks.filters[quality];
+		reset();
+	}
+
+	/** Returns the delay added by the resampler, in output frames */
+	float getLatency() {
+		return ResamplerFilter::getLatency(quality, inRate, outRate) * outRate;
+	}
+
+	/** Converts up to `*inFrames` frames from `in` to at most `*outFrames` frames in `out`.
+	On return, `*inFrames` and `*outFrames` are set to the number of frames consumed and produced.
+	*/
+	void process(const float *in, int *inFrames, float *out, int *outFrames) {
+		switch (filter->mode) {
+			case RESAMPLER_COPY: processCopy(in, inFrames, out, outFrames); break;
+			default: processPolyphase(in, inFrames, out, outFrames); break;
+		}
+	}
+
+	/** Overload for frame structs such as dsp::Frame<CHANNELS> */
+	template <typename TFrame>
+	void process(const TFrame *in, int *inFrames, TFrame *out, int *outFrames) {
+		static_assert(sizeof(TFrame) == CHANNELS * sizeof(float), "Frame must contain CHANNELS floats");
+		process((const float*) in, inFrames, (float*) out, outFrames);
+	}
+
+	void processCopy(const float *in, int *inFrames, float *out, int *outFrames) {
+		int frames = std::min(*inFrames, *outFrames);
+		if (channels == CHANNELS) {
+			memcpy(out, in, frames * CHANNELS * sizeof(float));
+		}
+		else {
+			for (int i = 0; i < frames; i++) {
+				for (int c = 0; c < channels; c++) {
+					out[i * CHANNELS + c] = in[i * CHANNELS + c];
+				}
+			}
+		}
+		*inFrames = frames;
+		*outFrames = frames;
+	}
+
+	void processPolyphase(const float *in, int *inFrames, float *out, int *outFrames) {
+		int taps = filter->taps;
+		int inIndex = 0;
+		int outIndex = 0;
+		while (outIndex < *outFrames) {
+			// Consume input until the output position lies between the two newest frames
+			while (phase >= filter->up) {
+				if (inIndex >= *inFrames)
+					goto done;
+				push(&in[inIndex * CHANNELS], taps);
+				inIndex++;
+				phase -= filter->up;
+			}
+
+			int row = phase;
+			if (filter->phases != filter->up)
+				row = (int) ((int64_t) phase * filter->phases / filter->up);
+			const float *coefficients = &filter->coefficients[row * taps];
+			for (int c = 0; c < channels; c++) {
+				out[outIndex * CHANNELS + c] = resamplerDot(&history[c][head], coefficients, taps);
+			}
+			outIndex++;
+			phase += filter->down;
+		}
+	done:
+		*inFrames = inIndex;
+		*outFrames = outIndex;
+	}
+
+	void push(const float *frame, int taps) {
+		for (int c = 0; c < channels; c++) {
+			history[c][head] = frame[c];
+			history[c][head + taps] = frame[c];
+		}
+		head++;
+		if (head >= taps)
+			head = 0;
+	}
+};